@@ -118,9 +118,25 @@ connect it to a different port or bit, change the macros below:
 #define DL_PORT_PULLUP      PORTB
 #define DL_PORT_INPUT       PINB
 #define DL_BIT              4
+/*
+ * Soft entry from the application: The magic put at the RAM location, with a
+ * watchdog reset, makes the boot loader stay, as with the Download switch. The
+ * location is above the boot loader's data & below its stack, at the check.
+ * Should match with the ones in LDDKFirmware/Code/main.c
+ */
+#define BOOT_MAGIC_ADDR     (RAMEND - 0x7F)
+#define BOOT_MAGIC          0xB007
+
+static uint8_t bootSoftEntry;
 
 static inline void  bootLoaderInit(void)
 {
+    if ((MCUCSR & _BV(WDRF)) && (*(volatile uint16_t *)(BOOT_MAGIC_ADDR) == BOOT_MAGIC))
+    {
+        bootSoftEntry = 1;
+    }
+    *(volatile uint16_t *)(BOOT_MAGIC_ADDR) = 0; /* Only for this reset */
+    MCUCSR &= ~_BV(WDRF);
     DL_PORT_PULLUP |= _BV(DL_BIT);   /* Activate pull-up for key */
     DL_PORT_DDR &= ~_BV(DL_BIT);     /* Make the switch bit an input */
     _delay_us(10);                   /* Wait for levels to stabilize */
@@ -138,7 +154,7 @@ static inline void  bootLoaderShut(void)
     MCUCSR |= (1 << JTD);            /* Confirm to Soft Disable JTAG */
 }
 
-#define bootLoaderCondition() ((DL_PORT_INPUT & _BV(DL_BIT)) == 0) /* True if switch is pressed */
+#define bootLoaderCondition() (bootSoftEntry || ((DL_PORT_INPUT & _BV(DL_BIT)) == 0)) /* True if soft entered or switch is pressed */
 #define toggleLED() (LED_PORT_OUTPUT ^= _BV(LED_BIT))
 
 #endif
@@ -39,4 +39,15 @@ int flash_read_block(const uint8_t *block_addr, uint8_t *data)
 	}
 	return 0;
 }
+int flash_cmp_block(const uint8_t *block_addr, const uint8_t *data)
+{
+	int i;
+
+	for (i = 0; i < BLOCK_SIZE; i++)
+	{
+		if (pgm_read_byte(block_addr + i) != data[i])
+			return 1;
+	}
+	return 0;
+}
 int (*flash_write_block)(uint8_t *block_addr, uint8_t *data) = (int (*)(uint8_t *, uint8_t *))(FWB_ADDR / 2);
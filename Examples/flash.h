@@ -20,5 +20,7 @@
 uint8_t flash_read_byte(const uint8_t *addr);
 /* block_addr should be BLOCK_SIZE aligned */
 int flash_read_block(const uint8_t *block_addr, uint8_t *data);
+/* Returns 0 if the block has the same contents as data, 1 otherwise */
+int flash_cmp_block(const uint8_t *block_addr, const uint8_t *data);
 int (*flash_write_block)(uint8_t *block_addr, uint8_t *data);
 #endif
@@ -128,6 +128,11 @@ void usart_init(unsigned long baud)
 
 	usart_enable();
 }
+void usart_config(unsigned long baud, uint8_t data_bits, Parity parity, uint8_t stop_bits)
+{
+	set_baud(baud);
+	set_format(data_bits, parity, stop_bits);
+}
 void usart_shut(void)
 {
 	usart_disable();
@@ -29,7 +29,7 @@
  * Supported data bits: 5, 6, 7, 8, 9
  * Supported parity: none (N), even (E), odd (O)
  * Supported stop bits: 1, 2
- * Currently, hardcoded setting is 8N1
+ * Default setting is 8N1, which can be changed using usart_config
  */
 
 typedef enum
@@ -40,6 +40,7 @@ typedef enum
 } Parity;
 
 void usart_init(unsigned long baud);
+void usart_config(unsigned long baud, uint8_t data_bits, Parity parity, uint8_t stop_bits);
 void usart_shut(void);
 void usart_enable(void);
 void usart_disable(void);
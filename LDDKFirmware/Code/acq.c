@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) eSrijan Innovations Private Limited
+ * 
+ * Author: Anil Kumar Pugalia <anil_pugalia@eSrijan.com>
+ *
+ * Licensed under: JSL (See LICENSE file for details)
+ *
+ * ATmega16/32
+ *
+ * Acquisition Buffer & Sampling Clock Functions
+ */
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include "acq.h"
+
+uint8_t acq_buf[ACQ_BUF_SIZE];
+static volatile AcqHandler acq_handler;
+
+ISR(TIMER0_COMP_vect, ISR_NOBLOCK)
+{
+	acq_handler();
+}
+
+uint32_t acq_clock_period(uint8_t cs, uint8_t ocr)
+{
+	static const uint8_t prescale_shift[] = { 3, 6, 8, 10 }; /* for cs from 2 */
+
+	if ((cs < 2) || (cs > 5))
+		return 0;
+	return (uint32_t)(ocr + 1) << prescale_shift[cs - 2];
+}
+int acq_clock_start(uint8_t cs, uint8_t ocr, AcqHandler handler)
+{
+	if (acq_clock_period(cs, ocr) < ACQ_MIN_PERIOD)
+		return -1;
+
+	acq_clock_stop();
+	acq_handler = handler;
+	TCNT0 = 0;
+	OCR0 = ocr;
+	TIFR = (1 << OCF0); /* Clear any stale compare match */
+	if (handler)
+	{
+		TIMSK |= (1 << OCIE0);
+	}
+	TCCR0 = (1 << WGM01) | (cs << CS00); /* CTC mode */
+	return 0;
+}
+void acq_clock_stop(void)
+{
+	TCCR0 = 0;
+	TIMSK &= ~(1 << OCIE0);
+}
@@ -0,0 +1,37 @@
+/*
+ * Copyright (C) eSrijan Innovations Private Limited
+ * 
+ * Author: Anil Kumar Pugalia <anil_pugalia@eSrijan.com>
+ *
+ * Licensed under: JSL (See LICENSE file for details)
+ *
+ * ATmega16/32
+ *
+ * Header for Acquisition Buffer & Sampling Clock Functions
+ *
+ * The buffer is shared by the sampling & playback modes, only one of which can
+ * be active at a time. The sampling clock is Timer0 in CTC mode, ticking every
+ * (ocr + 1) * prescaler CPU cycles, with clock select (cs) from 2 to 5, i.e.
+ * prescaler of 8, 64, 256, 1024. It is limited to ACQ_MIN_PERIOD cycles, i.e.
+ * 50 KHz at 16 MHz, as the tick handler runs with the USB interrupt enabled.
+ * Without a handler, the compare match can still auto trigger the ADC.
+ */
+
+#ifndef ACQ_H
+#define ACQ_H
+
+#include <avr/io.h>
+
+#define ACQ_BUF_SIZE 512 /* should be a power of 2 */
+#define ACQ_MIN_PERIOD 320 /* in CPU cycles */
+
+typedef void (*AcqHandler)(void);
+
+extern uint8_t acq_buf[ACQ_BUF_SIZE];
+
+/* Returns the period in CPU cycles, 0 for an invalid clock select */
+uint32_t acq_clock_period(uint8_t cs, uint8_t ocr);
+/* Returns 0 on success, -1 for an invalid or too fast clock. handler may be NULL */
+int acq_clock_start(uint8_t cs, uint8_t ocr, AcqHandler handler);
+void acq_clock_stop(void);
+#endif
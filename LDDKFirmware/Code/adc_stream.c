@@ -0,0 +1,178 @@
+/*
+ * Copyright (C) eSrijan Innovations Private Limited
+ * 
+ * Author: Anil Kumar Pugalia <anil_pugalia@eSrijan.com>
+ *
+ * Licensed under: JSL (See LICENSE file for details)
+ *
+ * ATmega16/32
+ *
+ * ADC Streaming Functions
+ */
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include "requests.h"
+#include "acq.h"
+#include "adc_stream.h"
+
+#define IDX_MASK (ACQ_BUF_SIZE - 1)
+
+static uint8_t adc_channels; /* Bit mask of ADC0-7 */
+static uint8_t adc_packed;
+static volatile uint8_t adc_st = ADC_ST_IDLE;
+/* Free running indices - head updated by the ADC interrupt, & tail by the reader */
+static volatile uint16_t adc_head, adc_tail;
+static uint32_t adc_bits; /* Sample bits yet to be packed into a byte */
+static uint8_t adc_bit_cnt;
+static volatile uint16_t adc_overruns;
+
+static uint8_t next_channel(uint8_t ch)
+{
+	do
+	{
+		ch = (ch + 1) & 0b111;
+	}
+	while (!(adc_channels & (1 << ch)));
+	return ch;
+}
+
+ISR(ADC_vect, ISR_NOBLOCK)
+{
+	uint16_t sample = adc_packed ? ADCW : ADCH;
+	uint16_t head = adc_head;
+
+	TIFR = (1 << OCF0); /* Re-arm the trigger, for the next compare match */
+	/* Applies from the next conversion */
+	ADMUX = (ADMUX & ~(0b11111 << MUX0)) | (next_channel(ADMUX & 0b111) << MUX0);
+
+	if ((uint16_t)(head - adc_tail) > ACQ_BUF_SIZE - 2) /* No room for the sample */
+	{
+		adc_overruns++;
+		return;
+	}
+	if (adc_packed)
+	{
+		adc_bits |= (uint32_t)(sample) << adc_bit_cnt;
+		adc_bit_cnt += 10;
+		while (adc_bit_cnt >= 8)
+		{
+			acq_buf[head++ & IDX_MASK] = adc_bits;
+			adc_bits >>= 8;
+			adc_bit_cnt -= 8;
+		}
+	}
+	else
+	{
+		acq_buf[head++ & IDX_MASK] = sample;
+	}
+	adc_head = head;
+}
+
+int adc_stream_start(uint8_t cs, uint8_t ocr, uint8_t channels, uint8_t packed)
+{
+	uint8_t ch;
+
+	if (!channels || (acq_clock_period(cs, ocr) < ADC_MIN_PERIOD))
+		return -1;
+
+	adc_stream_stop();
+	adc_channels = channels;
+	adc_packed = packed;
+	adc_head = adc_tail = 0;
+	adc_bits = 0;
+	adc_bit_cnt = 0;
+	adc_overruns = 0;
+	for (ch = 0; !(channels & (1 << ch)); ch++)
+		;
+	// Channel to be read for input between GND-AVCC
+	ADMUX = (1 << REFS0) | (packed ? 0 : (1 << ADLAR)) | (ch << MUX0);
+	// ADC clock should be between 50KHz to 200KHz
+#if (F_CPU < 100000)
+#error Processor frequency should be between 100 KHz & 20 MHz
+#elif (F_CPU <= 400000)
+	ADCSRA = (1 << ADPS0); // Prescaler is /2
+#elif (F_CPU <= 800000)
+	ADCSRA = (2 << ADPS0); // Prescaler is /4
+#elif (F_CPU <= 1600000)
+	ADCSRA = (3 << ADPS0); // Prescaler is /8
+#elif (F_CPU <= 3200000)
+	ADCSRA = (4 << ADPS0); // Prescaler is /16
+#elif (F_CPU <= 6400000)
+	ADCSRA = (5 << ADPS0); // Prescaler is /32
+#elif (F_CPU <= 12800000)
+	ADCSRA = (6 << ADPS0); // Prescaler is /64
+#elif (F_CPU <= 20000000)
+	ADCSRA = (7 << ADPS0); // Prescaler is /128
+#else
+#error Processor frequency should be between 100 KHz & 20 MHz
+#endif
+	SFIOR = (SFIOR & ~(0b111 << ADTS0)) | (0b011 << ADTS0); // Timer0 compare match
+	// Enable the ADC with Auto Trigger & its interrupt
+	ADCSRA |= (1 << ADEN) | (1 << ADATE) | (1 << ADIE);
+	adc_st = ADC_ST_RUNNING;
+	if (acq_clock_start(cs, ocr, 0) == -1)
+	{
+		adc_stream_stop();
+		return -1;
+	}
+	return 0;
+}
+void adc_stream_stop(void)
+{
+	if (adc_st == ADC_ST_RUNNING)
+	{
+		acq_clock_stop();
+		ADCSRA = 0;
+		if (adc_bit_cnt && ((uint16_t)(adc_head - adc_tail) < ACQ_BUF_SIZE)) /* Partial byte */
+		{
+			acq_buf[adc_head & IDX_MASK] = adc_bits;
+			adc_head++;
+		}
+		adc_st = ADC_ST_STOPPED;
+	}
+}
+uint8_t adc_stream_state(void)
+{
+	return adc_st;
+}
+uint16_t adc_stream_overruns(void)
+{
+	uint16_t cnt;
+	uint8_t sreg = SREG;
+
+	cli();
+	cnt = adc_overruns;
+	SREG = sreg;
+	return cnt;
+}
+uint8_t adc_stream_read(uint8_t *buf)
+{
+	uint16_t avail, tail;
+	uint8_t i, sreg = SREG;
+
+	cli();
+	avail = adc_head - adc_tail;
+	SREG = sreg;
+	if (avail < 8)
+	{
+		if (adc_st == ADC_ST_RUNNING)
+			return ADC_NOT_READY;
+		adc_st = ADC_ST_IDLE; /* Last of the samples */
+	}
+	else
+	{
+		avail = 8;
+	}
+	tail = adc_tail;
+	for (i = 0; i < avail; i++)
+	{
+		buf[i] = acq_buf[tail++ & IDX_MASK];
+	}
+	sreg = SREG;
+	cli();
+	adc_tail = tail;
+	SREG = sreg;
+	return avail;
+}
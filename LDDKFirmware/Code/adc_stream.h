@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) eSrijan Innovations Private Limited
+ * 
+ * Author: Anil Kumar Pugalia <anil_pugalia@eSrijan.com>
+ *
+ * Licensed under: JSL (See LICENSE file for details)
+ *
+ * ATmega16/32
+ *
+ * Header for ADC Streaming Functions
+ *
+ * The ADC is auto triggered by the sampling clock (Timer0 compare match),
+ * converting the selected channels (ADC0-7 on PA0-7) in turn, with AVCC as
+ * the reference. The samples are packed into the acquisition buffer, used as
+ * a ring, either as 8-bit (left adjusted) bytes, or as a 10-bit packed bit
+ * stream, LSB first, i.e. 4 samples in 5 bytes. Samples not fitting in the
+ * ring are dropped & counted as overruns. A conversion takes 13 ADC clocks
+ * of F_CPU / 128, limiting the sampling clock to ADC_MIN_PERIOD CPU cycles,
+ * i.e. about 9.6 KHz at 16 MHz, shared by all the channels selected. That is
+ * only in bursts though, as the ring is drained over the interrupt IN
+ * endpoint 1, polled every 10ms for 8 bytes, i.e. about 800 bytes a second.
+ * So, sustained, it is about 800 samples a second if 8-bit, or 640 if 10-bit.
+ */
+
+#ifndef ADC_STREAM_H
+#define ADC_STREAM_H
+
+#include <avr/io.h>
+
+#include "acq.h"
+
+#define ADC_MIN_PERIOD (13 * 128 + 16) /* in CPU cycles */
+#define ADC_NOT_READY 0xFF
+
+/* Returns 0 on success, -1 for invalid parameters */
+int adc_stream_start(uint8_t cs, uint8_t ocr, uint8_t channels, uint8_t packed);
+void adc_stream_stop(void);
+uint8_t adc_stream_state(void); /* ADC_ST_* */
+uint16_t adc_stream_overruns(void);
+/*
+ * Fills the next 8 bytes of the samples, if available, else returns
+ * ADC_NOT_READY. Once stopped, the last bytes are filled, with a short count.
+ */
+uint8_t adc_stream_read(uint8_t *buf);
+#endif
@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) eSrijan Innovations Private Limited
+ * 
+ * Author: Anil Kumar Pugalia <anil_pugalia@eSrijan.com>
+ *
+ * Licensed under: JSL (See LICENSE file for details)
+ *
+ * ATmega16/32
+ *
+ * Character LCD Framebuffer Functions
+ */
+
+#include <avr/io.h>
+
+#include "requests.h"
+#include "clcd.h"
+#include "clcd_fb.h"
+
+static uint8_t fb[CLCD_FB_SIZE];
+static uint8_t fb_dirty[CLCD_FB_SIZE / 8];
+static uint8_t fb_cursor;
+static uint8_t fb_moving; /* CLCD_FB_MOVE received, position awaited */
+static uint8_t lcd_pos; /* Where the next LCD data write goes */
+
+static void fb_put(uint8_t pos, uint8_t c)
+{
+	if (fb[pos] != c)
+	{
+		fb[pos] = c;
+		fb_dirty[pos >> 3] |= (1 << (pos & 7));
+	}
+}
+
+void clcd_fb_init(void)
+{
+	uint8_t i;
+
+	clcd_init(); /* Also clears the display */
+	for (i = 0; i < CLCD_FB_SIZE; i++)
+	{
+		fb[i] = ' ';
+	}
+	for (i = 0; i < sizeof(fb_dirty); i++)
+	{
+		fb_dirty[i] = 0;
+	}
+	fb_cursor = 0;
+	fb_moving = 0;
+	lcd_pos = 0;
+}
+void clcd_fb_cls(void)
+{
+	uint8_t i;
+
+	for (i = 0; i < CLCD_FB_SIZE; i++)
+	{
+		fb_put(i, ' ');
+	}
+	fb_cursor = 0;
+}
+void clcd_fb_println(uint8_t line, char *str)
+{
+	uint8_t i, pos = line ? 16 : 0;
+
+	for (i = 0; (i < 16) && str[i]; i++)
+	{
+		fb_put(pos + i, str[i]);
+	}
+	for (; i < 16; i++)
+	{
+		fb_put(pos + i, ' ');
+	}
+}
+void clcd_fb_write(uint8_t *data, uint8_t len)
+{
+	uint8_t c;
+
+	for (; len; len--)
+	{
+		c = *data++;
+		if (fb_moving)
+		{
+			fb_cursor = c & (CLCD_FB_SIZE - 1);
+			fb_moving = 0;
+			continue;
+		}
+		switch (c)
+		{
+			case '\b':
+				fb_cursor = (fb_cursor - 1) & (CLCD_FB_SIZE - 1);
+				break;
+			case '\r':
+				fb_cursor &= 16;
+				break;
+			case '\n':
+				fb_cursor = (fb_cursor & 16) ^ 16;
+				break;
+			case '\f':
+				clcd_fb_cls();
+				break;
+			case CLCD_FB_MOVE:
+				fb_moving = 1;
+				break;
+			default:
+				if (c >= 0x20)
+				{
+					fb_put(fb_cursor, c);
+					fb_cursor = (fb_cursor + 1) & (CLCD_FB_SIZE - 1);
+				}
+				break;
+		}
+	}
+}
+void clcd_fb_flush(void)
+{
+	uint8_t i, pos;
+
+	/* Look from where the LCD is, to save on the moves */
+	for (i = 0; i < CLCD_FB_SIZE; i++)
+	{
+		pos = (lcd_pos + i) & (CLCD_FB_SIZE - 1);
+		if (fb_dirty[pos >> 3] & (1 << (pos & 7)))
+			break;
+	}
+	if (i == CLCD_FB_SIZE)
+		return;
+
+	fb_dirty[pos >> 3] &= ~(1 << (pos & 7));
+	if (pos != lcd_pos)
+	{
+		clcd_move_to(pos);
+	}
+	clcd_data_wr(fb[pos]); /* Moves on to the next line or back to 0, by itself */
+	lcd_pos = (pos + 1) & (CLCD_FB_SIZE - 1);
+}
@@ -0,0 +1,44 @@
+/*
+ * Copyright (C) eSrijan Innovations Private Limited
+ * 
+ * Author: Anil Kumar Pugalia <anil_pugalia@eSrijan.com>
+ *
+ * Licensed under: JSL (See LICENSE file for details)
+ *
+ * ATmega16/32
+ *
+ * Header for Character LCD Framebuffer Functions
+ *
+ * The text is written into a framebuffer of the 32 cells (0-15 on the first
+ * line & 16-31 on the second), with the cells changed marked dirty. As every
+ * LCD write takes a couple of milliseconds, the dirty cells are written out
+ * one at a time on the flush, called from the main loop, so that the USB
+ * polling is never held up for long. The text stream has the characters
+ * (0x20 onwards) written at the cursor, which then moves right, wrapping
+ * around from 31 to 0, & the following control characters:
+ * 	'\b': Move the cursor one left
+ * 	'\r': Move the cursor to the start of its line
+ * 	'\n': Move the cursor to the start of the other line
+ * 	'\f': Clear the display & move the cursor to 0
+ * 	CLCD_FB_MOVE, position: Move the cursor to the position (0-31)
+ * Others are ignored.
+ */
+
+#ifndef CLCD_FB_H
+#define CLCD_FB_H
+
+#include <avr/io.h>
+
+#include "clcd.h"
+
+#define CLCD_FB_SIZE 32
+
+void clcd_fb_init(void);
+void clcd_fb_cls(void);
+/* Puts the string on the line (0 or 1), padded with spaces */
+void clcd_fb_println(uint8_t line, char *str);
+/* Interprets the text stream, which may be split anywhere */
+void clcd_fb_write(uint8_t *data, uint8_t len);
+/* Writes out the next dirty cell, if any */
+void clcd_fb_flush(void);
+#endif
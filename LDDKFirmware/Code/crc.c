@@ -0,0 +1,31 @@
+/*
+ * Copyright (C) eSrijan Innovations Private Limited
+ * 
+ * Author: Anil Kumar Pugalia <anil_pugalia@eSrijan.com>
+ *
+ * Licensed under: JSL (See LICENSE file for details)
+ *
+ * ATmega16/32
+ *
+ * CRC Functions
+ */
+
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+
+#include "crc.h"
+
+static const uint32_t crc32_table[16] PROGMEM =
+{
+	0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+	0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+	0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+	0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+uint32_t crc32_update(uint32_t crc, uint8_t data)
+{
+	crc = pgm_read_dword(&crc32_table[(crc ^ data) & 0x0F]) ^ (crc >> 4);
+	crc = pgm_read_dword(&crc32_table[(crc ^ (data >> 4)) & 0x0F]) ^ (crc >> 4);
+	return crc;
+}
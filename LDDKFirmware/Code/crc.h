@@ -0,0 +1,25 @@
+/*
+ * Copyright (C) eSrijan Innovations Private Limited
+ * 
+ * Author: Anil Kumar Pugalia <anil_pugalia@eSrijan.com>
+ *
+ * Licensed under: JSL (See LICENSE file for details)
+ *
+ * ATmega16/32
+ *
+ * Header for CRC Functions
+ *
+ * CRC-32 as of IEEE 802.3 (same as zlib's crc32), computed a nibble at a time
+ * from a 16 entry table in flash
+ */
+
+#ifndef CRC_H
+#define CRC_H
+
+#include <avr/io.h>
+
+#define CRC32_INIT 0xFFFFFFFFUL
+#define crc32_final(crc) ((crc) ^ 0xFFFFFFFFUL)
+
+uint32_t crc32_update(uint32_t crc, uint8_t data);
+#endif
@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) eSrijan Innovations Private Limited
+ * 
+ * Author: Anil Kumar Pugalia <anil_pugalia@eSrijan.com>
+ *
+ * Licensed under: JSL (See LICENSE file for details)
+ *
+ * ATmega16/32
+ *
+ * Queued EEPROM Write Functions
+ */
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/eeprom.h>
+
+#include "intr.h"
+#include "eeprom_q.h"
+
+static uint16_t eeq_addr[EEPROM_Q_SIZE];
+static uint8_t eeq_data[EEPROM_Q_SIZE];
+/* Free running indices - only the put updates head, & only the ISR tail */
+static volatile uint8_t eeq_head;
+static volatile uint8_t eeq_tail;
+static volatile uint16_t eeq_written; /* Bytes actually written */
+
+ISR_UNBLOCKED(EE_RDY_vect, EECR, EERIE)
+{
+	uint8_t i, data;
+
+	while (eeq_tail != eeq_head)
+	{
+		i = eeq_tail & (EEPROM_Q_SIZE - 1);
+		data = eeq_data[i];
+		EEAR = eeq_addr[i];
+		EECR |= (1 << EERE);
+		eeq_tail++;
+		if (EEDR != data) /* Skip, if unchanged */
+		{
+			EEDR = data;
+			eeq_written++;
+			cli(); /* EEWE has to follow EEMWE within 4 cycles */
+			EECR |= (1 << EEMWE);
+			EECR |= (1 << EEWE);
+			EECR |= (1 << EERIE); /* Interrupt again, once written */
+			return;
+		}
+	}
+}
+
+int eeprom_q_put(uint8_t *addr, uint8_t data)
+{
+	uint8_t i = eeq_head;
+
+	if ((uint8_t)(i - eeq_tail) >= EEPROM_Q_SIZE) /* Queue full */
+		return -1;
+	eeq_addr[i & (EEPROM_Q_SIZE - 1)] = (uint16_t)(addr);
+	eeq_data[i & (EEPROM_Q_SIZE - 1)] = data;
+	eeq_head = i + 1;
+	EECR |= (1 << EERIE);
+	return 0;
+}
+uint8_t eeprom_q_depth(void)
+{
+	return eeq_head - eeq_tail;
+}
+uint8_t eeprom_q_free(void)
+{
+	return EEPROM_Q_SIZE - eeprom_q_depth();
+}
+uint16_t eeprom_q_written(int reset)
+{
+	uint16_t cnt;
+	uint8_t sreg = SREG;
+
+	cli();
+	cnt = eeq_written;
+	if (reset)
+	{
+		eeq_written = 0;
+	}
+	SREG = sreg;
+	return cnt;
+}
+uint8_t eeprom_q_busy(void)
+{
+	return (eeq_head != eeq_tail) || (EECR & (1 << EEWE));
+}
+
+void eeprom_q_pause(void)
+{
+	EECR &= ~(1 << EERIE);
+	eeprom_busy_wait(); /* for the one being written, if any */
+}
+void eeprom_q_resume(void)
+{
+	if (eeq_head != eeq_tail)
+		EECR |= (1 << EERIE);
+}
+
+uint8_t eeprom_q_read_byte(const uint8_t *addr)
+{
+	uint8_t i;
+
+	EECR &= ~(1 << EERIE); /* Hold back the writes, till eeprom_q_resume() */
+	/* Latest of the queued ones, if any, is the one to be returned */
+	for (i = eeq_head; i != eeq_tail; i--)
+	{
+		if (eeq_addr[(i - 1) & (EEPROM_Q_SIZE - 1)] == (uint16_t)(addr))
+			return eeq_data[(i - 1) & (EEPROM_Q_SIZE - 1)];
+	}
+	eeprom_busy_wait(); /* for the one being written, if any */
+	return eeprom_read_byte(addr);
+}
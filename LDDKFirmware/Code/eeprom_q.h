@@ -0,0 +1,37 @@
+/*
+ * Copyright (C) eSrijan Innovations Private Limited
+ * 
+ * Author: Anil Kumar Pugalia <anil_pugalia@eSrijan.com>
+ *
+ * Licensed under: JSL (See LICENSE file for details)
+ *
+ * ATmega16/32
+ *
+ * Header for Queued EEPROM Write Functions
+ *
+ * Bytes put into the queue are written in the background, driven by the EEPROM
+ * ready interrupt. Bytes already having the same value are not re-written.
+ */
+
+#ifndef EEPROM_Q_H
+#define EEPROM_Q_H
+
+#include <avr/io.h>
+
+#define EEPROM_Q_SIZE 32 /* in bytes; should be a power of 2 */
+
+int eeprom_q_put(uint8_t *addr, uint8_t data);
+uint8_t eeprom_q_depth(void);
+uint8_t eeprom_q_free(void);
+uint8_t eeprom_q_busy(void);
+uint16_t eeprom_q_written(int reset); /* Bytes actually written, i.e. not skipped */
+/*
+ * Reads also account for the bytes still in the queue. Others are read from the
+ * EEPROM, after the byte being written, if any, with the further writes held
+ * back till eeprom_q_resume(). So, a run of reads waits for at most one write.
+ */
+uint8_t eeprom_q_read_byte(const uint8_t *addr);
+/* Pause & Resume the background writes, say for a flash write */
+void eeprom_q_pause(void);
+void eeprom_q_resume(void);
+#endif
@@ -0,0 +1,180 @@
+/*
+ * Copyright (C) eSrijan Innovations Private Limited
+ * 
+ * Author: Anil Kumar Pugalia <anil_pugalia@eSrijan.com>
+ *
+ * Licensed under: JSL (See LICENSE file for details)
+ *
+ * ATmega16/32
+ *
+ * GPIO Change Event Functions
+ */
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <string.h>
+
+#include "requests.h"
+#include "regs.h"
+#include "timer.h"
+#include "evt.h"
+
+#define PORT_CNT 4 /* A to D */
+#define BT_BIT 2 /* PB2 on INT2 */
+
+static volatile uint8_t *evt_pin[PORT_CNT];
+static uint8_t evt_mask[PORT_CNT];
+static uint8_t evt_last[PORT_CNT];
+static uint8_t evt_q[EVT_Q_SIZE][8];
+/* Free running indices - head updated by the interrupts, & tail by the reader */
+static volatile uint8_t evt_head, evt_tail;
+
+/*
+ * The event interrupts are blocked, instead of masking all the interrupts, as
+ * the scan is too long to hold back the USB interrupt. Returns the ones enabled.
+ */
+static uint8_t evt_block(void)
+{
+	uint8_t en = (TIMSK & (1 << OCIE1A)) | (GICR & (1 << INT2));
+
+	TIMSK &= ~(1 << OCIE1A);
+	GICR &= ~(1 << INT2);
+	return en;
+}
+static void evt_unblock(uint8_t en)
+{
+	TIMSK |= (en & (1 << OCIE1A));
+	GICR |= (en & (1 << INT2));
+}
+
+/* Called with the event interrupts blocked */
+static void evt_check(uint8_t port)
+{
+	uint8_t val, changed, *e;
+	uint32_t ts;
+
+	val = *evt_pin[port] & evt_mask[port];
+	changed = val ^ evt_last[port];
+	if (!changed)
+	{
+		return;
+	}
+	evt_last[port] = val;
+	ts = timer_now();
+	if ((evt_head != evt_tail) && /* Previous event of the port yet to be read */
+		(evt_q[(evt_head - 1) & (EVT_Q_SIZE - 1)][0] == REG_PORTA + port))
+	{
+		e = evt_q[(evt_head - 1) & (EVT_Q_SIZE - 1)];
+		e[2] |= changed;
+		if (e[3] < 0xFF)
+		{
+			e[3]++;
+		}
+	}
+	else if ((uint8_t)(evt_head - evt_tail) < EVT_Q_SIZE)
+	{
+		e = evt_q[evt_head & (EVT_Q_SIZE - 1)];
+		e[0] = REG_PORTA + port;
+		e[2] = changed;
+		e[3] = 1;
+		evt_head++;
+	}
+	else /* Queue full - lost */
+	{
+		return;
+	}
+	e[1] = val;
+	e[4] = ts & 0xFF;
+	e[5] = (ts >> 8) & 0xFF;
+	e[6] = (ts >> 16) & 0xFF;
+	e[7] = (ts >> 24) & 0xFF;
+}
+
+ISR(TIMER1_COMPA_vect, ISR_NOBLOCK)
+{
+	uint8_t en = evt_block();
+	uint8_t port;
+
+	cli(); /* TEMP is shared with the capture handler */
+	OCR1A += EVT_SCAN_TICKS;
+	sei();
+	for (port = 0; port < PORT_CNT; port++)
+	{
+		if (evt_mask[port])
+		{
+			evt_check(port);
+		}
+	}
+	evt_unblock(en);
+}
+ISR(INT2_vect, ISR_NOBLOCK)
+{
+	uint8_t en;
+
+	if (!(evt_mask[REG_PORTB - REG_PORTA] & (1 << BT_BIT))) /* Armed for the remote wakeup */
+		return;
+	en = evt_block();
+
+	/* Catch the next edge, either way */
+	if (PINB & (1 << BT_BIT))
+		MCUCSR &= ~(1 << ISC2);
+	else
+		MCUCSR |= (1 << ISC2);
+	GIFR = (1 << INTF2); /* Changing the edge may raise the flag */
+	evt_check(REG_PORTB - REG_PORTA);
+	evt_unblock(en);
+}
+
+int evt_watch(uint8_t reg, uint8_t mask)
+{
+	volatile uint8_t *wr_reg, *rd_reg;
+	uint8_t wr_mask, rd_mask, port, sreg;
+
+	if ((reg < REG_PORTA) || !get_reg(reg, &wr_reg, &wr_mask, &rd_reg, &rd_mask))
+		return -1;
+
+	evt_block();
+	port = reg - REG_PORTA;
+	evt_pin[port] = rd_reg;
+	evt_mask[port] = mask & ~rd_mask;
+	evt_last[port] = *evt_pin[port] & evt_mask[port];
+	if (!evt_watching())
+	{
+		evt_head = evt_tail = 0;
+		return 0; /* Event interrupts stay blocked */
+	}
+	sreg = SREG;
+	cli(); /* TEMP is shared with the capture handler */
+	OCR1A = TCNT1 + EVT_SCAN_TICKS;
+	SREG = sreg;
+	TIFR = (1 << OCF1A);
+	TIMSK |= (1 << OCIE1A);
+	if (evt_mask[REG_PORTB - REG_PORTA] & (1 << BT_BIT))
+	{
+		if (PINB & (1 << BT_BIT))
+			MCUCSR &= ~(1 << ISC2); /* Falling edge */
+		else
+			MCUCSR |= (1 << ISC2); /* Rising edge */
+		GIFR = (1 << INTF2);
+		GICR |= (1 << INT2);
+	}
+	return 0;
+}
+uint8_t evt_watching(void)
+{
+	return evt_mask[0] | evt_mask[1] | evt_mask[2] | evt_mask[3];
+}
+uint8_t evt_read(uint8_t *buf)
+{
+	uint8_t en;
+
+	if (evt_head == evt_tail)
+	{
+		return evt_watching() ? EVT_NOT_READY : 0;
+	}
+	en = evt_block(); /* As the last event may be getting coalesced into */
+	memcpy(buf, evt_q[evt_tail & (EVT_Q_SIZE - 1)], 8);
+	evt_tail++;
+	evt_unblock(en);
+	return 8;
+}
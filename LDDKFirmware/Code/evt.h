@@ -0,0 +1,39 @@
+/*
+ * Copyright (C) eSrijan Innovations Private Limited
+ * 
+ * Author: Anil Kumar Pugalia <anil_pugalia@eSrijan.com>
+ *
+ * Licensed under: JSL (See LICENSE file for details)
+ *
+ * ATmega16/32
+ *
+ * Header for GPIO Change Event Functions
+ *
+ * The watched bits of the ports are scanned for changes every EVT_SCAN_TICKS
+ * on the Timer1 compare A interrupt, with Timer1 continuing to run free. PB2
+ * (the BUTTON), if watched, is also caught right away on INT2. INT1 (PD3) is
+ * the USB D-, & so is not available. Each change is queued as an 8 byte event:
+ * register index (REG_PORTA to REG_PORTD), new value of the watched bits, bits
+ * changed, number of changes coalesced, & the time stamp (4 bytes, LSB first,
+ * in Timer1 ticks). A change on a port, whose previous event is yet to be
+ * read, is coalesced into it. With the queue full, further events are lost.
+ */
+
+#ifndef EVT_H
+#define EVT_H
+
+#include <avr/io.h>
+
+#include "timer.h"
+
+#define EVT_SCAN_TICKS (1000 * TIMER_TICKS_PER_US) /* 1ms */
+#define EVT_Q_SIZE 8 /* in events; should be a power of 2 */
+#define EVT_NOT_READY 0xFF
+
+/* Watches the bits in the mask of the port, or stops watching it with a 0 mask */
+/* Returns 0 on success, -1 for an invalid port */
+int evt_watch(uint8_t reg, uint8_t mask);
+uint8_t evt_watching(void);
+/* Fills the next event, if any, else returns EVT_NOT_READY, or 0 once not watching */
+uint8_t evt_read(uint8_t *buf);
+#endif
@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) eSrijan Innovations Private Limited
+ * 
+ * Author: Anil Kumar Pugalia <anil_pugalia@eSrijan.com>
+ *
+ * Licensed under: JSL (See LICENSE file for details)
+ *
+ * ATmega16/32
+ *
+ * USB to I2C Bridge Functions
+ */
+
+#include <avr/io.h>
+
+#include "requests.h"
+#include "twi.h"
+#include "i2c_bridge.h"
+
+static uint8_t inited;
+
+void i2c_bridge_init(uint8_t fast_mode)
+{
+	twi_init(fast_mode ? fast : standard);
+	inited = 1;
+}
+
+uint8_t i2c_bridge_run(const uint8_t *batch, uint8_t batch_len, uint8_t *res)
+{
+	uint8_t i = 0, res_len = 0;
+	uint8_t addr, wr_len, rd_len;
+	int ret;
+
+	if (!inited)
+	{
+		i2c_bridge_init(0);
+	}
+	while (i + 3 <= batch_len)
+	{
+		addr = batch[i];
+		wr_len = batch[i + 1];
+		rd_len = batch[i + 2];
+		i += 3;
+		if ((i + wr_len > batch_len) || (res_len + 1 + rd_len > I2C_BATCH_SIZE))
+		{
+			break;
+		}
+		if (rd_len == 0)
+		{
+			ret = twi_master_tx(addr, (uint8_t *)(batch + i), wr_len);
+		}
+		else if (wr_len == 0)
+		{
+			ret = twi_master_rx(addr, res + res_len + 1, rd_len);
+		}
+		else
+		{
+			ret = twi_master_tx_rx(addr, (uint8_t *)(batch + i), wr_len, res + res_len + 1, rd_len);
+		}
+		res[res_len] = ret ? I2C_ST_FAIL : 0;
+		res_len += 1 + rd_len;
+		i += wr_len;
+	}
+	return res_len;
+}
@@ -0,0 +1,29 @@
+/*
+ * Copyright (C) eSrijan Innovations Private Limited
+ * 
+ * Author: Anil Kumar Pugalia <anil_pugalia@eSrijan.com>
+ *
+ * Licensed under: JSL (See LICENSE file for details)
+ *
+ * ATmega16/32
+ *
+ * Header for USB to I2C Bridge Functions
+ *
+ * A batch of I2C transactions is run back-to-back through the I2C library.
+ * Each transaction in the batch is laid out as: 7-bit slave address, write
+ * length, read length, followed by the bytes to write. It results into a
+ * status (0 for success, I2C_ST_FAIL otherwise), followed by the read length
+ * bytes read. A write followed by a read is done with a repeated start.
+ */
+
+#ifndef I2C_BRIDGE_H
+#define I2C_BRIDGE_H
+
+#include <avr/io.h>
+
+#define I2C_BATCH_SIZE 64 /* in bytes, for the transactions as well as their results */
+
+void i2c_bridge_init(uint8_t fast_mode); /* Standard (100KHz) by default */
+/* Returns the results length, with the transactions not fitting in skipped */
+uint8_t i2c_bridge_run(const uint8_t *batch, uint8_t batch_len, uint8_t *res);
+#endif
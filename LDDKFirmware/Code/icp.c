@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) eSrijan Innovations Private Limited
+ * 
+ * Author: Anil Kumar Pugalia <anil_pugalia@eSrijan.com>
+ *
+ * Licensed under: JSL (See LICENSE file for details)
+ *
+ * ATmega16/32
+ *
+ * Input Capture Measurement Functions
+ */
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include "requests.h"
+#include "timer.h"
+#include "icp.h"
+
+static uint8_t icp_mode;
+static uint8_t rise_valid, fall_valid;
+static uint32_t last_rise, last_fall;
+static volatile uint32_t period_sum, high_sum, pulses;
+static volatile uint16_t period_cnt;
+
+static inline void put32(uint8_t *buf, uint32_t v)
+{
+	buf[0] = v & 0xFF;
+	buf[1] = (v >> 8) & 0xFF;
+	buf[2] = (v >> 16) & 0xFF;
+	buf[3] = (v >> 24) & 0xFF;
+}
+
+/* Called with the capture interrupt blocked */
+static void icp_edge(uint8_t rising, uint32_t ts)
+{
+	if (!rising)
+	{
+		last_fall = ts;
+		fall_valid = rise_valid;
+		return;
+	}
+	pulses++;
+	if (rise_valid && (fall_valid || (icp_mode != ICP_MODE_PULSE)))
+	{
+		period_sum += ts - last_rise;
+		if (fall_valid)
+		{
+			high_sum += last_fall - last_rise;
+		}
+		period_cnt++;
+	}
+	last_rise = ts;
+	rise_valid = 1;
+	fall_valid = 0;
+}
+
+ISR(TIMER1_CAPT_vect, ISR_NOBLOCK)
+{
+	uint16_t icr;
+	uint8_t rising;
+	uint32_t now;
+
+	TIMSK &= ~(1 << TICIE1); /* Not to nest into itself */
+	cli(); /* TEMP is shared with the other Timer1 registers */
+	icr = ICR1;
+	sei();
+	rising = TCCR1B & (1 << ICES1);
+	now = timer_now();
+	/* Captured within the last 65536 ticks, so go back from now */
+	icp_edge(rising, now - (uint16_t)((uint16_t)now - icr));
+	if (icp_mode == ICP_MODE_PULSE)
+	{
+		TCCR1B ^= (1 << ICES1); /* Catch the other edge */
+		TIFR = (1 << ICF1); /* Flipping the edge may raise the flag */
+		if (!(PIND & (1 << PD6)) != !rising) /* Other edge already gone by */
+		{
+			TCCR1B ^= (1 << ICES1);
+			TIFR = (1 << ICF1);
+			rise_valid = fall_valid = 0;
+		}
+	}
+	TIMSK |= (1 << TICIE1);
+}
+
+int icp_start(uint8_t mode, uint8_t noise_cancel)
+{
+	if (mode > ICP_MODE_PULSE)
+		return -1;
+	if ((mode != ICP_MODE_OFF) && (MASK_PORTD & (1 << PD6))) /* Used by the Character LCD */
+		return -1;
+
+	TIMSK &= ~(1 << TICIE1);
+	icp_mode = mode;
+	rise_valid = fall_valid = 0;
+	period_sum = high_sum = pulses = 0;
+	period_cnt = 0;
+	if (mode == ICP_MODE_OFF)
+		return 0;
+
+	DDRD &= ~(1 << PD6);
+	/* Timer1 keeps its clock select, as the time base */
+	TCCR1B = (TCCR1B & ~((1 << ICNC1) | (1 << ICES1))) |
+				(noise_cancel ? (1 << ICNC1) : 0) | (1 << ICES1); /* Rising edge */
+	TIFR = (1 << ICF1);
+	TIMSK |= (1 << TICIE1);
+	return 0;
+}
+void icp_read(uint8_t *buf)
+{
+	uint8_t en = TIMSK & (1 << TICIE1);
+	uint32_t p_sum, h_sum, cnt;
+	uint16_t p_cnt;
+
+	TIMSK &= ~(1 << TICIE1);
+	p_sum = period_sum;
+	h_sum = high_sum;
+	p_cnt = period_cnt;
+	cnt = pulses;
+	period_sum = high_sum = 0;
+	period_cnt = 0;
+	TIMSK |= en;
+
+	put32(buf, p_cnt ? (p_sum / p_cnt) : 0);
+	put32(buf + 4, p_cnt ? (h_sum / p_cnt) : 0);
+	buf[8] = p_cnt & 0xFF;
+	buf[9] = (p_cnt >> 8) & 0xFF;
+	put32(buf + 10, cnt);
+}
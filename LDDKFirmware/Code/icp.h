@@ -0,0 +1,37 @@
+/*
+ * Copyright (C) eSrijan Innovations Private Limited
+ * 
+ * Author: Anil Kumar Pugalia <anil_pugalia@eSrijan.com>
+ *
+ * Licensed under: JSL (See LICENSE file for details)
+ *
+ * ATmega16/32
+ *
+ * Header for Input Capture Measurement Functions
+ *
+ * The edges on ICP1/PD6 (Pin 20) are time stamped by the Timer1 input capture,
+ * with Timer1 continuing to run free as the time base, i.e. at a resolution of
+ * 1 CPU cycle (62.5ns at 16MHz). In the period mode, only the rising edges are
+ * captured, & in the pulse mode, both, by flipping the edge after each capture.
+ * The periods & the high times, between the reads, are summed up & reported
+ * as averages, along with the running count of pulses (rising edges). Edges
+ * closer than the capture handler latency, i.e. a few 10s of us with the USB
+ * active, may be missed. A pulse with a missed edge is left out.
+ */
+
+#ifndef ICP_H
+#define ICP_H
+
+#include <avr/io.h>
+
+#define ICP_RESULT_SIZE 14
+
+/* Returns 0 on success, -1 for an invalid mode or a protected PD6. ICP_MODE_OFF stops */
+int icp_start(uint8_t mode, uint8_t noise_cancel);
+/*
+ * Fills in the average period, average high time (4 bytes each, in CPU cycles),
+ * number of periods averaged (2 bytes), & the count of pulses (4 bytes), all
+ * LSB first, & starts the averaging afresh.
+ */
+void icp_read(uint8_t *buf);
+#endif
@@ -0,0 +1,41 @@
+/*
+ * Copyright (C) eSrijan Innovations Private Limited
+ * 
+ * Author: Anil Kumar Pugalia <anil_pugalia@eSrijan.com>
+ *
+ * Licensed under: JSL (See LICENSE file for details)
+ *
+ * ATmega16/32
+ *
+ * Header for Interrupt Handler Helpers
+ *
+ * The USB interrupt (INT0) must not be kept pending for more than a few
+ * cycles. So, any other interrupt handler has to enable the interrupts right
+ * upfront. For a level triggered interrupt (like USART Rx complete, USART data
+ * register empty, EEPROM ready), its own enable bit has to be cleared before
+ * that, or else it would re-trigger immediately. ISR_UNBLOCKED does both in a
+ * tiny vector stub, and then jumps to the handler body which follows it. The
+ * handler body is responsible to set the enable bit back, as and when needed.
+ * reg has to be an I/O register in the bit addressable range.
+ */
+
+#ifndef INTR_H
+#define INTR_H
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#define ISR_UNBLOCKED(vector, reg, bit) ISR_UNBLOCKED_(vector, reg, bit)
+#define ISR_UNBLOCKED_(vector, reg, bit) \
+	void vector ## _unblocked(void) __attribute__((signal, used)); \
+	ISR(vector, ISR_NAKED) \
+	{ \
+		asm volatile ( \
+			"cbi %0, %1" "\n\t" \
+			"sei" "\n\t" \
+			"jmp " #vector "_unblocked" \
+			:: "I" (_SFR_IO_ADDR(reg)), "I" (bit) \
+		); \
+	} \
+	void vector ## _unblocked(void)
+#endif
@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) eSrijan Innovations Private Limited
+ * 
+ * Author: Anil Kumar Pugalia <anil_pugalia@eSrijan.com>
+ *
+ * Licensed under: JSL (See LICENSE file for details)
+ *
+ * ATmega16/32
+ *
+ * Logic Analyzer Functions
+ */
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include "requests.h"
+#include "regs.h"
+#include "acq.h"
+#include "la.h"
+
+#define IDX_MASK (LA_SAMPLES - 1)
+
+static volatile uint8_t *la_pin;
+static uint8_t la_bits; /* Unmasked bits of the port */
+static uint8_t la_trig_type, la_trig_mask, la_trig_val;
+static uint16_t la_pre_trig;
+static volatile uint8_t la_st = LA_ST_IDLE;
+static volatile uint16_t la_head; /* Next sample index */
+static volatile uint16_t la_cnt; /* Valid samples in the ring */
+static volatile uint16_t la_post; /* Samples yet to be taken after the trigger */
+static uint8_t la_prev; /* Previous sample, for the edge trigger */
+static uint16_t la_rd, la_rd_cnt; /* Read out index & samples remaining */
+
+static void la_sample(void)
+{
+	uint8_t s = *la_pin & la_bits;
+
+	acq_buf[la_head] = s;
+	la_head = (la_head + 1) & IDX_MASK;
+	if (la_cnt < LA_SAMPLES)
+	{
+		la_cnt++;
+	}
+	if (la_st == LA_ST_ARMED)
+	{
+		if ((la_trig_type == LA_TRIG_NONE) ||
+			(((s & la_trig_mask) == la_trig_val) &&
+			((la_trig_type == LA_TRIG_LEVEL) ||
+			((la_cnt > 1) && ((la_prev & la_trig_mask) != la_trig_val)))))
+		{
+			if (la_cnt - 1 > la_pre_trig) /* Keep only the pre-trigger samples asked for */
+			{
+				la_cnt = la_pre_trig + 1;
+			}
+			la_post = LA_SAMPLES - la_cnt;
+			la_st = LA_ST_TRIGGERED;
+		}
+		la_prev = s;
+	}
+	else if (la_st == LA_ST_TRIGGERED)
+	{
+		la_post--;
+	}
+	if ((la_st == LA_ST_TRIGGERED) && !la_post)
+	{
+		acq_clock_stop();
+		la_rd = (la_head - la_cnt) & IDX_MASK;
+		la_rd_cnt = la_cnt;
+		la_st = LA_ST_DONE;
+	}
+}
+
+int la_start(uint8_t reg, uint8_t cs, uint8_t ocr, uint8_t trig_type,
+				uint8_t trig_mask, uint8_t trig_val, uint16_t pre_trig)
+{
+	volatile uint8_t *wr_reg;
+	uint8_t wr_mask, rd_mask;
+
+	if ((reg < REG_PORTA) || !get_reg(reg, &wr_reg, &wr_mask, &la_pin, &rd_mask))
+		return -1;
+	if ((trig_type > LA_TRIG_EDGE) || (pre_trig >= LA_SAMPLES))
+		return -1;
+
+	la_stop();
+	la_bits = ~rd_mask;
+	la_trig_type = trig_type;
+	la_trig_mask = trig_mask & la_bits;
+	la_trig_val = trig_val & la_trig_mask;
+	la_pre_trig = pre_trig;
+	la_head = la_cnt = 0;
+	la_rd_cnt = 0;
+	la_st = LA_ST_ARMED;
+	if (acq_clock_start(cs, ocr, la_sample) == -1)
+	{
+		la_st = LA_ST_IDLE;
+		return -1;
+	}
+	return 0;
+}
+void la_stop(void)
+{
+	if ((la_st == LA_ST_ARMED) || (la_st == LA_ST_TRIGGERED))
+	{
+		acq_clock_stop();
+	}
+	la_st = LA_ST_IDLE;
+}
+uint8_t la_state(void)
+{
+	return la_st;
+}
+uint16_t la_count(void)
+{
+	uint16_t cnt;
+	uint8_t sreg = SREG;
+
+	cli();
+	cnt = la_cnt;
+	SREG = sreg;
+	return cnt;
+}
+uint8_t la_read(uint8_t *buf)
+{
+	uint8_t len = 0, val, run;
+
+	while ((len < 8) && la_rd_cnt)
+	{
+		val = acq_buf[la_rd];
+		run = 0; /* Repeat count - 1 */
+		for (;;)
+		{
+			la_rd = (la_rd + 1) & IDX_MASK;
+			la_rd_cnt--;
+			if (!la_rd_cnt || (acq_buf[la_rd] != val) || (run == 255))
+				break;
+			run++;
+		}
+		buf[len++] = val;
+		buf[len++] = run;
+	}
+	return len;
+}
@@ -0,0 +1,36 @@
+/*
+ * Copyright (C) eSrijan Innovations Private Limited
+ * 
+ * Author: Anil Kumar Pugalia <anil_pugalia@eSrijan.com>
+ *
+ * Licensed under: JSL (See LICENSE file for details)
+ *
+ * ATmega16/32
+ *
+ * Header for Logic Analyzer Functions
+ *
+ * The unmasked bits of a port are sampled on every tick of the sampling clock
+ * into the acquisition buffer, used as a ring till the trigger. After that,
+ * the ring is filled up (leaving the pre-trigger samples) & the capture stops.
+ * The captured samples are then read out run length encoded, as pairs of the
+ * sample & its repeat count - 1.
+ */
+
+#ifndef LA_H
+#define LA_H
+
+#include <avr/io.h>
+
+#include "acq.h"
+
+#define LA_SAMPLES ACQ_BUF_SIZE
+
+/* Returns 0 on success, -1 for invalid parameters */
+int la_start(uint8_t reg, uint8_t cs, uint8_t ocr, uint8_t trig_type,
+				uint8_t trig_mask, uint8_t trig_val, uint16_t pre_trig);
+void la_stop(void);
+uint8_t la_state(void); /* LA_ST_* */
+uint16_t la_count(void); /* Samples captured */
+/* Fills upto 8 bytes (4 pairs) of the run length encoded capture; less marks the end */
+uint8_t la_read(uint8_t *buf);
+#endif
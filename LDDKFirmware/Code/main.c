@@ -25,9 +25,7 @@ at least be connected to INT0 as well.
 //#define USE_WD /* Enabling this, resets it pretty often, say even when controlling the LEDs */
 
 #include <avr/io.h>
-#ifdef USE_WD
-#include <avr/wdt.h>
-#endif
+#include <avr/wdt.h>        /* also for the reset into the bootloader */
 #include <avr/interrupt.h>  /* for sei() */
 #include <avr/pgmspace.h>   /* required by usbdrv.h */
 #include <util/delay.h>     /* for _delay_ms() */
@@ -37,11 +35,16 @@ at least be connected to INT0 as well.
 #include "usbdrv.h"
 #include "oddebug.h"        /* This is also an example for using debug macros */
 #include "requests.h"       /* The custom request numbers we use */
+#include "rq.h"             /* The request handlers */
 #ifdef USE_CLCD
 #include "clcd.h"           /* clcd for display, debugging */
 #endif
-#include "serial.h"         /* serial communication */
+#include "serial_ring.h"    /* buffered serial communication */
 #include "flash.h"
+#include "eeprom_q.h"        /* background EEPROM writes */
+#include "crc.h"
+#include "timer.h"
+#include "power.h"          /* USB suspend */
 
 /*
 We assume that an active high LED is connected to port B bit 7. If you connect
@@ -56,11 +59,20 @@ connect it to a different port or bit, change the macros below:
 #define SW_PORT_INPUT       PINB
 #define BT_BIT              2 /* Button switch */
 #define DL_BIT              4 /* Download switch */
+/*
+ * Soft entry into the bootloader: The magic put at the RAM location, with a
+ * watchdog reset, makes the bootloader stay, as with the Download switch.
+ * Should match with the ones in BootloadHID/firmware/bootloaderconfig.h
+ */
+#define BOOT_MAGIC_ADDR     (RAMEND - 0x7F)
+#define BOOT_MAGIC          0xB007
 
 typedef enum
 {
     eeprom,
     flash,
+    sram,
+    io,
     total_mem_type
 } mem_type_t;
 static mem_type_t mem_type;
@@ -72,44 +84,136 @@ static unsigned mem_rd_off;
 static unsigned mem_wr_off;
 static unsigned fwp_buf_off;
 static unsigned char flash_write_page_buffer[SPM_PAGESIZE];
+/*
+ * A filled up flash_write_page_buffer is committed (erased & written) from the
+ * main loop, between the USB polls. Till then, USB requests are NAKed, and the
+ * rest of the packet which filled up the page is held in mem_wr_carry. So is the
+ * rest of one finding the EEPROM queue full, till it drains.
+ */
+static uint8_t fwp_pending; /* Page awaiting commit */
+static uint8_t fwp_flush; /* Partial page to be written after the pending one */
+static unsigned fwp_page_off; /* Offset of the page awaiting commit */
+static uint8_t mem_wr_carry[8];
+static uint8_t mem_wr_carry_len;
+/* Pages committed, out of which skipped as unchanged, & actually erased-n-written */
+static uint16_t fwp_written, fwp_skipped, fwp_erased;
 
-#ifdef USE_CLCD
-static void println1(char *str)
+static unsigned mem_blk_off; /* Offset for the ongoing block read */
+static unsigned mem_blk_len; /* Bytes remaining in the ongoing block write */
+
+#define CRC_CHUNK 128 /* Bytes per main loop pass, ~0.5ms */
+
+/* CRC of a memory range, computed a chunk at a time from the main loop */
+static uint8_t (*crc_read_byte)(const uint8_t *);
+static unsigned crc_addr;
+static unsigned crc_len; /* Bytes remaining */
+static uint32_t crc_val;
+
+#define SER_IDLE_OVFS 2 /* Serial receive idle timeout, in Timer1 overflows (~4ms each) */
+
+/* Serial line coding, as in CDC: dwDTERate, bCharFormat, bParityType, bDataBits */
+static uint8_t ser_line[7] = { 0x80, 0x25, 0x00, 0x00, 0, 0, 8 }; /* 9600 8N1 */
+#define ser_line_buf (rq_scratch) /* Line coding being received */
+static uint8_t ser_line_len;
+
+/*
+ * Data to be sent over the interrupt IN endpoint 1, in place of the memory
+ * data, say results of a sequence run or a logic analyzer capture. Memory data
+ * resumes once it is done.
+ */
+typedef enum
 {
-    uint8_t i;
+    ep1_mem,
+    ep1_data_sending,
+    ep1_data_sent
+} ep1_state_t;
+static ep1_state_t ep1_state;
+static Ep1Filler ep1_fill;
+static uint8_t *ep1_data; /* Data to be sent, when filled from a buffer */
+static unsigned ep1_data_len; /* Bytes remaining */
 
-    clcd_move_to(0);
-    for (i = 0; (i < 16) && str[i]; i++)
-    {
-        clcd_data_wr(str[i]);
-    }
-    for (; i < 16; i++)
-    {
-        clcd_data_wr(' ');
-    }
-}
-#if (DEBUG_LEVEL > 0)
-static void println2(char *str)
+uchar rq_buf[RQ_BUF_SIZE]; /* must stay valid after the handler returns */
+RqWriter rq_write; /* Set by the request handlers expecting data */
+uint8_t rq_scratch[RQ_SCRATCH_SIZE];
+
+static uint8_t boot_pending; /* Reset into the bootloader, once the request is done */
+#define SERIAL_NUMBER_ADDR EEPROM_SIZE /* Just after the memory accessible EEPROM */
+static int sn_descr[1 + SERIAL_NUMBER_LEN]; /* Serial number string descriptor */
+static unsigned sn_wr_len; /* Bytes remaining of the serial number being written */
+static uint8_t sn_wr_off;
+/* The serial number to be queued for the EEPROM from the main loop, once there is room */
+static uint8_t sn_new[SERIAL_NUMBER_LEN];
+static uint8_t sn_pending;
+
+/* Firmware statistics, sent as is, i.e. LSB first, for CUSTOM_RQ_GET_STATS */
+static struct
 {
-    uint8_t i;
+    uint16_t loops_per_sec;
+    uint16_t poll_max; /* in Timer1 ticks */
+    uint16_t poll_avg; /* in Timer1 ticks, over the last second */
+    uint16_t ep1_in_pkts;
+    uint16_t ep3_in_pkts;
+    uint16_t ep1_out_pkts;
+    uint16_t ep2_out_pkts;
+    uint16_t ser_rx_overruns;
+    uint16_t eeprom_bytes;
+    uint32_t flash_bytes;
+} stats;
+static uint32_t stats_win_start; /* Start of the current one second window */
+static uint16_t stats_win_loops;
+static uint32_t stats_win_poll; /* Total usbPoll() duration in the window */
+static uint8_t ep1_queued; /* Packet set on EP1, yet to be taken by the host */
+
+/*
+ * usbTxLen is not exported by usbdrv.h. But it is a single byte, set by usbPoll()
+ * & put back to USBPID_NAK by the USB interrupt once sent, & so is safe to read
+ * from the main loop, as long as it is only read.
+ */
+uint8_t usb_ctrl_idle(void)
+{
+    extern volatile uchar usbTxLen; /* from usbdrv.c */
 
-    clcd_move_to(16);
-    for (i = 0; (i < 16) && str[i]; i++)
+    return (usbTxLen == USBPID_NAK);
+}
+
+static void enter_bootloader(void)
+{
+    if (!usb_ctrl_idle()) // Let the status stage of the request go first
     {
-        clcd_data_wr(str[i]);
+        return;
     }
-    for (; i < 16; i++)
+    if (fwp_pending || sn_pending || eeprom_q_busy()) // Let the writes complete
     {
-        clcd_data_wr(' ');
+        return;
     }
+    cli(); /* Nothing else to touch the RAM, anymore */
+    *(volatile uint16_t *)(BOOT_MAGIC_ADDR) = BOOT_MAGIC;
+    usbDeviceDisconnect(); /* Let the host know right away */
+    wdt_enable(WDTO_15MS);
+    for (;;)
+        ;
 }
-#define printlnd(str) println2(str)
-#else
-#define printlnd(str)
+
+static void suspend(void)
+{
+    uint8_t led = LED_PORT_OUTPUT & _BV(LED_BIT);
+
+    LED_PORT_OUTPUT &= ~_BV(LED_BIT);
+#ifdef USE_CLCD
+    clcd_cmd_wr(0x08); /* Display off */
 #endif
-#else
-#define printlnd(str)
+#ifdef USE_WD
+    wdt_disable(); /* Would otherwise reset it in the power down */
 #endif
+    power_suspend();
+#ifdef USE_WD
+    wdt_enable(WDTO_1S);
+#endif
+#ifdef USE_CLCD
+    clcd_cmd_wr(0x0C); /* Display on */
+#endif
+    LED_PORT_OUTPUT |= led;
+}
 
 static void jtag_disable(void)
 {
@@ -120,20 +224,57 @@ static void jtag_disable(void)
     }
 }
 
-static void pre_load_mem_data(void)
+static void set_ep1_packet(uchar *data, uchar len)
+{
+    usbSetInterrupt(data, len);
+    ep1_queued = 1;
+}
+
+static uint8_t data_read_byte(const uint8_t *addr)
+{
+    if (addr == &UDR) // Would take the received byte away from the serial ring
+    {
+        return 0;
+    }
+    return *(volatile const uint8_t *)(addr);
+}
+
+/*
+ * SRAM & I/O registers are read a 2-byte word (from an even address) at a time,
+ * with the interrupts masked, so that the 16-bit values are consistent
+ */
+static uint8_t read_mem_data(unsigned off, uint8_t *mem_buf, uint8_t len)
 {
-    uint8_t mem_buf[8];
     uint8_t mem_i;
+    uint8_t sreg = SREG;
+    unsigned addr;
 
-    for (mem_i = 0; mem_i < 8; mem_i++)
+    for (mem_i = 0; (mem_i < len) && (off + mem_i < mem_size); mem_i++)
     {
-        if (mem_rd_off + mem_i >= mem_size)
+        addr = mem_start + off + mem_i;
+        if ((mem_type >= sram) && !(addr & 1))
         {
-            break;
+            cli();
+        }
+        mem_buf[mem_i] = mem_read_byte((uint8_t *)(addr));
+        if (addr & 1)
+        {
+            SREG = sreg;
         }
-        mem_buf[mem_i] = mem_read_byte((uint8_t *)(mem_start + mem_rd_off + mem_i));
     }
-    usbSetInterrupt((uchar *)mem_buf, mem_i);
+    SREG = sreg;
+    return mem_i;
+}
+
+static void pre_load_mem_data(void)
+{
+    uint8_t mem_buf[8];
+
+    if (ep1_state != ep1_mem) // Would be pre-loaded once the endpoint is free
+    {
+        return;
+    }
+    set_ep1_packet((uchar *)mem_buf, read_mem_data(mem_rd_off, mem_buf, 8));
 }
 
 static void set_mem_type(mem_type_t mt)
@@ -144,7 +285,7 @@ static void set_mem_type(mem_type_t mt)
         mem_start = EEPROM_START;
         mem_size = EEPROM_SIZE - EEPROM_START;
         mem_offset_mask = (mem_size - 1);
-        mem_read_byte = eeprom_read_byte;
+        mem_read_byte = eeprom_q_read_byte;
         mem_rd_off = 0;
         mem_wr_off = 0;
         fwp_buf_off = 0;
@@ -160,218 +301,925 @@ static void set_mem_type(mem_type_t mt)
         mem_wr_off = 0;
         fwp_buf_off = 0;
     }
+    else if (mt == sram)
+    {
+        mem_type = sram;
+        mem_start = RAMSTART;
+        mem_size = RAMEND + 1 - RAMSTART;
+        mem_offset_mask = (mem_size - 1);
+        mem_read_byte = data_read_byte;
+        mem_rd_off = 0;
+        mem_wr_off = 0;
+        fwp_buf_off = 0;
+    }
+    else if (mt == io)
+    {
+        mem_type = io;
+        mem_start = __SFR_OFFSET; // I/O registers as in the data space
+        mem_size = RAMSTART - __SFR_OFFSET;
+        mem_offset_mask = (mem_size - 1);
+        mem_read_byte = data_read_byte;
+        mem_rd_off = 0;
+        mem_wr_off = 0;
+        fwp_buf_off = 0;
+    }
     /*
      * Whether usbInterruptIsReady or not, let's set the Interrupt Endpoint data.
      * Basically overwriting the previous one.
      */
     pre_load_mem_data();
 }
-/* ------------------------------------------------------------------------- */
-/* ----------------------------- USB interface ----------------------------- */
-/* ------------------------------------------------------------------------- */
-
-usbMsgLen_t usbFunctionSetup(uchar data[8])
+static void set_mem_wr_off(unsigned off)
 {
-    usbRequest_t *rq = (void *)data;
-    static uchar dataBuffer[4]; /* buffer must stay valid when usbFunctionSetup returns */
     uint8_t mem_i;
 
-    if (rq->bRequest == CUSTOM_RQ_ECHO) { /* echo -- used for reliability tests */
-        dataBuffer[0] = rq->wValue.bytes[0];
-        dataBuffer[1] = rq->wValue.bytes[1];
-        dataBuffer[2] = rq->wIndex.bytes[0];
-        dataBuffer[3] = rq->wIndex.bytes[1];
-        usbMsgPtr = dataBuffer;         /* tell the driver which data to return */
-        return 4;
-    } else if (rq->bRequest == CUSTOM_RQ_SET_LED_STATUS) {
-        if (rq->wValue.bytes[0] & 1){    /* set LED */
-            LED_PORT_OUTPUT |= _BV(LED_BIT); /* active high */
-            printlnd("LED Status: ON");
-        } else {                          /* clear LED */
-            LED_PORT_OUTPUT &= ~_BV(LED_BIT); /* inactive low */
-            printlnd("LED Status: OFF");
-        }
-    } else if(rq->bRequest == CUSTOM_RQ_GET_LED_STATUS) {
-        dataBuffer[0] = ((LED_PORT_OUTPUT & _BV(LED_BIT)) != 0); /* active high */
-        usbMsgPtr = dataBuffer;         /* tell the driver which data to return */
-        return 1;                       /* tell the driver to send 1 byte */
-    } else if (rq->bRequest == CUSTOM_RQ_SET_MEM_RD_OFFSET) {
-        printlnd("Mem Rd Off: SET");
-        mem_rd_off = rq->wValue.word;
-        if (mem_rd_off > mem_size)
-        {
-            mem_rd_off = mem_size;
-        }
-        /*
-         * Whether usbInterruptIsReady or not, let's set the Interrupt Endpoint data.
-         * Basically overwriting the previous one.
-         */
-        pre_load_mem_data();
-    } else if(rq->bRequest == CUSTOM_RQ_GET_MEM_RD_OFFSET) {
-        printlnd("Mem Rd Off: GET");
-        dataBuffer[0] = mem_rd_off & 0xFF;
-        dataBuffer[1] = (mem_rd_off >> 8) & 0xFF;
-        usbMsgPtr = dataBuffer;         /* tell the driver which data to return */
-        return 2;                       /* tell the driver to send 2 bytes */
-    } else if (rq->bRequest == CUSTOM_RQ_SET_MEM_WR_OFFSET) {
-        printlnd("Mem Wr Off: SET");
-        mem_wr_off = rq->wValue.word;
-        if (mem_wr_off > mem_size)
+    mem_wr_off = off;
+    if (mem_wr_off > mem_size)
+    {
+        mem_wr_off = mem_size;
+    }
+    if (mem_type == flash)
+    {
+        fwp_buf_off = mem_wr_off & (SPM_PAGESIZE - 1);
+        if (fwp_buf_off) // Page non-aligned offset - read the page till fwp_buf_off
         {
-            mem_wr_off = mem_size;
+            for (mem_i = 0; mem_i < fwp_buf_off; mem_i++)
+                flash_write_page_buffer[mem_i] =
+                    mem_read_byte((uint8_t *)(mem_start + (mem_wr_off & ~(SPM_PAGESIZE - 1)) + mem_i));
         }
-        if (mem_type == flash)
+    }
+}
+
+static void write_mem_data(uchar *data, uchar len)
+{
+    uchar mem_i;
+
+    if (mem_wr_off + len > mem_size)
+    {
+        len = mem_size - mem_wr_off;
+    }
+    for (mem_i = 0; mem_i < len; mem_i++)
+    {
+        if (mem_type == eeprom)
         {
-            fwp_buf_off = mem_wr_off & (SPM_PAGESIZE - 1);
-            if (fwp_buf_off) // Page non-aligned offset - read the page till fwp_buf_off
+            if (eeprom_q_put((uint8_t *)(mem_start + mem_wr_off), *(uint8_t *)(data + mem_i)) < 0)
             {
-                for (mem_i = 0; mem_i < fwp_buf_off; mem_i++)
-                    flash_write_page_buffer[mem_i] =
-                        mem_read_byte((uint8_t *)(mem_start + (mem_wr_off & ~(SPM_PAGESIZE - 1)) + mem_i));
+                // Queue full - take in the rest from the main loop, once it drains
+                mem_wr_carry_len = len - mem_i;
+                memmove(mem_wr_carry, data + mem_i, mem_wr_carry_len);
+                usbDisableAllRequests(); // NAK any further data till then
+                return;
             }
         }
-    } else if(rq->bRequest == CUSTOM_RQ_GET_MEM_WR_OFFSET) {
-        printlnd("Mem Wr Off: GET");
-        dataBuffer[0] = mem_wr_off & 0xFF;
-        dataBuffer[1] = (mem_wr_off >> 8) & 0xFF;
-        usbMsgPtr = dataBuffer;         /* tell the driver which data to return */
-        return 2;                       /* tell the driver to send 2 bytes */
-    } else if(rq->bRequest == CUSTOM_RQ_GET_MEM_SIZE) {
-        printlnd("Mem Get Size");
-        dataBuffer[0] = mem_size & 0xFF;
-        dataBuffer[1] = (mem_size >> 8) & 0xFF;
-        usbMsgPtr = dataBuffer;         /* tell the driver which data to return */
-        return 2;                       /* tell the driver to send 2 bytes */
-    } else if (rq->bRequest == CUSTOM_RQ_SET_MEM_TYPE) {
-        printlnd("Mem Set Type");
-        if (rq->wValue.bytes[0] < total_mem_type)
+        else if (mem_type == flash)
         {
-            set_mem_type(rq->wValue.bytes[0]);
-        }
-    } else if(rq->bRequest == CUSTOM_RQ_GET_MEM_TYPE) {
-        printlnd("Mem Get Type");
-        dataBuffer[0] = mem_type;
-        usbMsgPtr = dataBuffer;         /* tell the driver which data to return */
-        return 1;                       /* tell the driver to send 1 byte */
-    } else if (rq->bRequest == CUSTOM_RQ_SET_REGISTER) {
-        printlnd("Reg Set");
-        switch (rq->wIndex.bytes[0])
-        {
-            case REG_RSVD:
-                break;
-            case REG_DIRA:
-                DDRA = (rq->wValue.bytes[0] & ~MASK_PORTA) | (DDRA & MASK_PORTA);
-                break;
-            case REG_DIRB:
-                DDRB = (rq->wValue.bytes[0] & ~MASK_PORTB) | (DDRB & MASK_PORTB);
-                break;
-            case REG_DIRC:
-                DDRC = (rq->wValue.bytes[0] & ~MASK_PORTC) | (DDRC & MASK_PORTC);
-                break;
-            case REG_DIRD:
-                if ((rq->wValue.bytes[0] & ~MASK_PORTD) & 0b11) // PD0 & PD1 - are going to be used
-                    usart_disable(); // Serial needs to be disabled
-                DDRD = (rq->wValue.bytes[0] & ~MASK_PORTD) | (DDRD & MASK_PORTD);
-                if (!((rq->wValue.bytes[0] & ~MASK_PORTD) & 0b11)) // PD0 & PD1 - no longer being used
-                    usart_enable(); // Serial can be re-enabled
-                break;
-            case REG_PORTA:
-                PORTA = (rq->wValue.bytes[0] & ~MASK_PORTA) | (PORTA & MASK_PORTA);
-                break;
-            case REG_PORTB:
-                PORTB = (rq->wValue.bytes[0] & ~MASK_PORTB) | (PORTB & MASK_PORTB);
-                break;
-            case REG_PORTC:
-                PORTC = (rq->wValue.bytes[0] & ~MASK_PORTC) | (PORTC & MASK_PORTC);
-                break;
-            case REG_PORTD:
-                PORTD = (rq->wValue.bytes[0] & ~MASK_PORTD) | (PORTD & MASK_PORTD);
-                break;
-            default:
-                break;
+            flash_write_page_buffer[fwp_buf_off++] = *(uint8_t *)(data + mem_i);
+            if (fwp_buf_off == SPM_PAGESIZE) // Page filled up - commit it from the main loop
+            {
+                mem_wr_off++;
+                fwp_page_off = mem_wr_off - SPM_PAGESIZE;
+                fwp_buf_off = 0;
+                fwp_pending = 1;
+                mem_wr_carry_len = len - mem_i - 1;
+                memmove(mem_wr_carry, data + mem_i + 1, mem_wr_carry_len);
+                usbDisableAllRequests(); // NAK any further data till then
+                return;
+            }
         }
-    } else if(rq->bRequest == CUSTOM_RQ_GET_REGISTER) {
-        printlnd("Reg Get");
-        switch (rq->wIndex.bytes[0])
+        mem_wr_off++;
+    }
+    if ((mem_type == eeprom) && (eeprom_q_free() < 8))
+    {
+        usbDisableAllRequests(); // NAK any further data till the queue drains
+    }
+}
+
+static void flush_flash_page(void)
+{
+    uint8_t mem_i;
+
+    if (mem_type != flash)
+    {
+        return;
+    }
+    if (fwp_pending) // Flush once the pending one is done
+    {
+        fwp_flush = 1;
+        return;
+    }
+    if (fwp_buf_off == 0) // Nothing partially filled
+    {
+        return;
+    }
+    /* Complete the page with its current contents, and commit it */
+    fwp_page_off = mem_wr_off - fwp_buf_off;
+    for (mem_i = fwp_buf_off; mem_i < SPM_PAGESIZE; mem_i++)
+        flash_write_page_buffer[mem_i] = mem_read_byte((uint8_t *)(mem_start + fwp_page_off + mem_i));
+    fwp_pending = 1;
+    usbDisableAllRequests();
+}
+
+static void commit_flash_page(void)
+{
+    uint8_t len;
+
+    if (!fwp_pending)
+    {
+        return;
+    }
+    fwp_written++;
+    if (flash_cmp_block((uint8_t *)(mem_start + fwp_page_off), flash_write_page_buffer))
+    {
+        eeprom_q_pause(); // An ongoing EEPROM write blocks the flash write
+        flash_write_block((uint8_t *)(mem_start + fwp_page_off), flash_write_page_buffer);
+        eeprom_q_resume();
+        fwp_erased++;
+        stats.flash_bytes += SPM_PAGESIZE;
+    }
+    else // Unchanged - spare the erase & write
+    {
+        fwp_skipped++;
+    }
+    fwp_pending = 0;
+    if (mem_wr_carry_len) // Now, take in the rest of the packet
+    {
+        len = mem_wr_carry_len;
+        mem_wr_carry_len = 0;
+        write_mem_data(mem_wr_carry, len);
+    }
+    if (fwp_flush)
+    {
+        fwp_flush = 0;
+        flush_flash_page();
+    }
+}
+
+static void commit_serial_number(void)
+{
+    uint8_t i;
+
+    if (!sn_pending || (eeprom_q_free() < SERIAL_NUMBER_LEN))
+    {
+        return;
+    }
+    for (i = 0; i < SERIAL_NUMBER_LEN; i++)
+    {
+        eeprom_q_put((uint8_t *)(SERIAL_NUMBER_ADDR + i), sn_new[i]);
+    }
+    sn_pending = 0;
+}
+
+static void resume_requests(void)
+{
+    uint8_t len;
+
+    if (!usbAllRequestsAreDisabled())
+    {
+        return;
+    }
+    if (mem_wr_carry_len && !fwp_pending && (eeprom_q_free() >= mem_wr_carry_len)) // Room for the rest of the packet
+    {
+        len = mem_wr_carry_len;
+        mem_wr_carry_len = 0;
+        write_mem_data(mem_wr_carry, len);
+    }
+    if (fwp_pending || (eeprom_q_free() < 8) || (serial_ring_tx_free() < 8)) // Still not ready for more data
+    {
+        return;
+    }
+#ifdef USE_ACQ
+    if (rq_acq_busy())
+    {
+        return;
+    }
+#endif
+#ifdef USE_BUS
+    if (rq_bus_busy())
+    {
+        return;
+    }
+#endif
+    usbEnableAllRequests();
+}
+
+static void start_mem_crc(unsigned off, unsigned len)
+{
+    if (off > mem_size)
+    {
+        off = mem_size;
+    }
+    if (len > mem_size - off)
+    {
+        len = mem_size - off;
+    }
+    /* Memory type fixed at the start, even if it gets changed midway */
+    crc_read_byte = mem_read_byte;
+    crc_addr = mem_start + off;
+    crc_len = len;
+    crc_val = CRC32_INIT;
+}
+
+static void update_mem_crc(void)
+{
+    unsigned len;
+
+    for (len = CRC_CHUNK; len && crc_len; len--, crc_len--)
+    {
+        crc_val = crc32_update(crc_val, crc_read_byte((uint8_t *)(crc_addr++)));
+    }
+}
+
+static void set_serial_line(void)
+{
+    unsigned long baud;
+    Parity parity;
+
+    baud = ser_line_buf[0] | ((unsigned long)(ser_line_buf[1]) << 8) |
+        ((unsigned long)(ser_line_buf[2]) << 16) | ((unsigned long)(ser_line_buf[3]) << 24);
+    if ((baud < 600) || (baud > 250000)) // Beyond what UBRR can take
+    {
+        return;
+    }
+    if ((ser_line_buf[6] < 5) || (ser_line_buf[6] > 9))
+    {
+        return;
+    }
+    switch (ser_line_buf[5])
+    {
+        case 1:
+            parity = p_odd;
+            break;
+        case 2:
+            parity = p_even;
+            break;
+        default: // Mark & space not supported - fall back to none
+            parity = p_none;
+            break;
+    }
+    /* 1.5 stop bits not supported - taken as 1 */
+    usart_config(baud, ser_line_buf[6], parity, (ser_line_buf[4] == 2) ? 2 : 1);
+    memcpy(ser_line, ser_line_buf, sizeof(ser_line));
+}
+
+static uint8_t fill_ep1_data(uint8_t *buf)
+{
+    uint8_t len = (ep1_data_len < 8) ? ep1_data_len : 8;
+
+    memcpy(buf, ep1_data, len);
+    ep1_data += len;
+    ep1_data_len -= len;
+    return len;
+}
+
+static void send_ep1_data(void)
+{
+    uint8_t buf[8];
+    uint8_t len = ep1_fill(buf);
+
+    if (len > 8) // Not ready - retry in the next loop
+    {
+        return;
+    }
+    set_ep1_packet(buf, len);
+    if (len < 8) // Short packet marks the end
+    {
+        ep1_state = ep1_data_sent;
+    }
+}
+
+void start_ep1_data(Ep1Filler fill)
+{
+    ep1_fill = fill;
+    ep1_state = ep1_data_sending;
+    usbTxLen1 = USBPID_NAK; // Drop the pre-loaded memory data, if not yet taken
+    ep1_queued = 0;
+    send_ep1_data();
+}
+
+void start_ep1_buf(uint8_t *data, unsigned len)
+{
+    ep1_data = data;
+    ep1_data_len = len;
+    start_ep1_data(fill_ep1_data);
+}
+
+uint8_t ep1_sending(Ep1Filler fill)
+{
+    return (ep1_state == ep1_data_sending) && (ep1_fill == fill);
+}
+
+static void update_stats(uint32_t poll_start)
+{
+    uint32_t now = timer_now();
+    uint32_t poll = now - poll_start;
+
+    if (poll > 0xFFFF)
+    {
+        poll = 0xFFFF;
+    }
+    if (poll > stats.poll_max)
+    {
+        stats.poll_max = poll;
+    }
+    stats_win_poll += poll;
+    stats_win_loops++;
+    if (now - stats_win_start >= F_CPU) // A second is over
+    {
+        stats.loops_per_sec = stats_win_loops;
+        stats.poll_avg = stats_win_poll / stats_win_loops;
+        stats_win_start = now;
+        stats_win_loops = 0;
+        stats_win_poll = 0;
+    }
+    if (ep1_queued && usbInterruptIsReady()) // Taken by the host
+    {
+        stats.ep1_in_pkts++;
+        ep1_queued = 0;
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/* ---------------------------- Request handlers --------------------------- */
+/* ------------------------------------------------------------------------- */
+
+static usbMsgLen_t rq_echo(usbRequest_t *rq) /* echo -- used for reliability tests */
+{
+    rq_buf[0] = rq->wValue.bytes[0];
+    rq_buf[1] = rq->wValue.bytes[1];
+    rq_buf[2] = rq->wIndex.bytes[0];
+    rq_buf[3] = rq->wIndex.bytes[1];
+    usbMsgPtr = rq_buf;             /* tell the driver which data to return */
+    return 4;
+}
+
+static usbMsgLen_t rq_set_led_status(usbRequest_t *rq)
+{
+    if (rq->wValue.bytes[0] & 1){    /* set LED */
+        LED_PORT_OUTPUT |= _BV(LED_BIT); /* active high */
+        printlnd("LED Status: ON");
+    } else {                          /* clear LED */
+        LED_PORT_OUTPUT &= ~_BV(LED_BIT); /* inactive low */
+        printlnd("LED Status: OFF");
+    }
+    return 0;
+}
+
+static usbMsgLen_t rq_get_led_status(usbRequest_t *rq UNUSED)
+{
+    rq_buf[0] = ((LED_PORT_OUTPUT & _BV(LED_BIT)) != 0); /* active high */
+    usbMsgPtr = rq_buf;             /* tell the driver which data to return */
+    return 1;                       /* tell the driver to send 1 byte */
+}
+
+static usbMsgLen_t rq_set_mem_rd_offset(usbRequest_t *rq)
+{
+    printlnd("Mem Rd Off: SET");
+    mem_rd_off = rq->wValue.word;
+    if (mem_rd_off > mem_size)
+    {
+        mem_rd_off = mem_size;
+    }
+    /*
+     * Whether usbInterruptIsReady or not, let's set the Interrupt Endpoint data.
+     * Basically overwriting the previous one.
+     */
+    pre_load_mem_data();
+    return 0;
+}
+
+static usbMsgLen_t rq_get_mem_rd_offset(usbRequest_t *rq UNUSED)
+{
+    printlnd("Mem Rd Off: GET");
+    rq_buf[0] = mem_rd_off & 0xFF;
+    rq_buf[1] = (mem_rd_off >> 8) & 0xFF;
+    usbMsgPtr = rq_buf;             /* tell the driver which data to return */
+    return 2;                       /* tell the driver to send 2 bytes */
+}
+
+static usbMsgLen_t rq_set_mem_wr_offset(usbRequest_t *rq)
+{
+    printlnd("Mem Wr Off: SET");
+    set_mem_wr_off(rq->wValue.word);
+    return 0;
+}
+
+static usbMsgLen_t rq_get_mem_wr_offset(usbRequest_t *rq UNUSED)
+{
+    printlnd("Mem Wr Off: GET");
+    rq_buf[0] = mem_wr_off & 0xFF;
+    rq_buf[1] = (mem_wr_off >> 8) & 0xFF;
+    usbMsgPtr = rq_buf;             /* tell the driver which data to return */
+    return 2;                       /* tell the driver to send 2 bytes */
+}
+
+static usbMsgLen_t rq_get_mem_size(usbRequest_t *rq UNUSED)
+{
+    printlnd("Mem Get Size");
+    rq_buf[0] = mem_size & 0xFF;
+    rq_buf[1] = (mem_size >> 8) & 0xFF;
+    usbMsgPtr = rq_buf;             /* tell the driver which data to return */
+    return 2;                       /* tell the driver to send 2 bytes */
+}
+
+static usbMsgLen_t rq_set_mem_type(usbRequest_t *rq)
+{
+    printlnd("Mem Set Type");
+    if (rq->wValue.bytes[0] < total_mem_type)
+    {
+        set_mem_type(rq->wValue.bytes[0]);
+    }
+    return 0;
+}
+
+static usbMsgLen_t rq_get_mem_type(usbRequest_t *rq UNUSED)
+{
+    printlnd("Mem Get Type");
+    rq_buf[0] = mem_type;
+    usbMsgPtr = rq_buf;             /* tell the driver which data to return */
+    return 1;                       /* tell the driver to send 1 byte */
+}
+
+static usbMsgLen_t rq_read_block(usbRequest_t *rq)
+{
+    printlnd("Mem Rd Block");
+    mem_blk_off = rq->wIndex.word;
+    return USB_NO_MSG;              /* use usbFunctionRead() to send the data */
+}
+
+static uchar mem_blk_write(uchar *data, uchar len)
+{
+    if (len > mem_blk_len)
+    {
+        len = mem_blk_len;
+    }
+    write_mem_data(data, len);
+    mem_blk_len -= len;
+    if (mem_blk_len)
+    {
+        return 0; /* expecting more data */
+    }
+    flush_flash_page();
+    printlnd("Memory block written");
+    return 1;
+}
+
+static usbMsgLen_t rq_write_block(usbRequest_t *rq)
+{
+    printlnd("Mem Wr Block");
+    rq_write = mem_blk_write;
+    set_mem_wr_off(rq->wIndex.word);
+    mem_blk_len = rq->wLength.word;
+    if (mem_blk_len == 0)
+    {
+        return 0;
+    }
+    return USB_NO_MSG;              /* use usbFunctionWrite() to receive the data */
+}
+
+static usbMsgLen_t rq_get_mem_wr_status(usbRequest_t *rq UNUSED)
+{
+    printlnd("Mem Wr Status");
+    rq_buf[0] = eeprom_q_depth();
+    rq_buf[1] = !(eeprom_q_busy() || fwp_pending || sn_pending);
+    usbMsgPtr = rq_buf;             /* tell the driver which data to return */
+    return 2;                       /* tell the driver to send 2 bytes */
+}
+
+static usbMsgLen_t rq_get_flash_wr_stats(usbRequest_t *rq)
+{
+    printlnd("Flash Wr Stats");
+    rq_buf[0] = fwp_written & 0xFF;
+    rq_buf[1] = (fwp_written >> 8) & 0xFF;
+    rq_buf[2] = fwp_skipped & 0xFF;
+    rq_buf[3] = (fwp_skipped >> 8) & 0xFF;
+    rq_buf[4] = fwp_erased & 0xFF;
+    rq_buf[5] = (fwp_erased >> 8) & 0xFF;
+    if (rq->wValue.bytes[0] & 1)
+    {
+        fwp_written = fwp_skipped = fwp_erased = 0;
+    }
+    usbMsgPtr = rq_buf;             /* tell the driver which data to return */
+    return 6;                       /* tell the driver to send 6 bytes */
+}
+
+static usbMsgLen_t rq_start_mem_crc(usbRequest_t *rq)
+{
+    printlnd("Mem Start CRC");
+    start_mem_crc(rq->wValue.word, rq->wIndex.word);
+    return 0;
+}
+
+static usbMsgLen_t rq_get_mem_crc(usbRequest_t *rq UNUSED)
+{
+    uint32_t crc;
+
+    printlnd("Mem Get CRC");
+    crc = crc32_final(crc_val);
+    rq_buf[0] = (crc_len != 0);
+    rq_buf[1] = crc & 0xFF;
+    rq_buf[2] = (crc >> 8) & 0xFF;
+    rq_buf[3] = (crc >> 16) & 0xFF;
+    rq_buf[4] = (crc >> 24) & 0xFF;
+    usbMsgPtr = rq_buf;             /* tell the driver which data to return */
+    return 5;                       /* tell the driver to send 5 bytes */
+}
+
+static uchar ser_line_write(uchar *data, uchar len)
+{
+    for (; len && (ser_line_len < sizeof(ser_line)); len--)
+    {
+        ser_line_buf[ser_line_len++] = *data++;
+    }
+    if (ser_line_len < sizeof(ser_line))
+    {
+        return 0; /* expecting more data */
+    }
+    set_serial_line();
+    printlnd("Serial line set");
+    return 1;
+}
+
+static usbMsgLen_t rq_set_serial_line(usbRequest_t *rq UNUSED)
+{
+    printlnd("Serial Set Line");
+    rq_write = ser_line_write;
+    ser_line_len = 0;
+    return USB_NO_MSG;              /* use usbFunctionWrite() to receive the data */
+}
+
+static usbMsgLen_t rq_get_serial_line(usbRequest_t *rq UNUSED)
+{
+    printlnd("Serial Get Line");
+    usbMsgPtr = ser_line;           /* tell the driver which data to return */
+    return sizeof(ser_line);        /* tell the driver to send 7 bytes */
+}
+
+static usbMsgLen_t rq_enter_bootloader(usbRequest_t *rq UNUSED)
+{
+    printlnd("Enter Bootloader");
+    boot_pending = 1;
+    return 0;
+}
+
+static uchar sn_write(uchar *data, uchar len)
+{
+    if (len > sn_wr_len)
+    {
+        len = sn_wr_len;
+    }
+    sn_wr_len -= len;
+    for (; len && (sn_wr_off < SERIAL_NUMBER_LEN); len--)
+    {
+        sn_new[sn_wr_off++] = *data++;
+    }
+    if (sn_wr_len)
+    {
+        return 0; /* expecting more data */
+    }
+    sn_pending = 1;
+    printlnd("Serial Num set");
+    return 1;
+}
+
+static usbMsgLen_t rq_set_serial_number(usbRequest_t *rq)
+{
+    printlnd("Set Serial Num");
+    rq_write = sn_write;
+    sn_wr_len = rq->wLength.word;
+    sn_wr_off = 0;
+    sn_pending = 0; // Superseded, if yet to be queued
+    memset(sn_new, 0xFF, sizeof(sn_new)); // Terminates a shorter one
+    if (sn_wr_len == 0) // Erase it
+    {
+        sn_pending = 1;
+        return 0;
+    }
+    return USB_NO_MSG;              /* use usbFunctionWrite() to receive the data */
+}
+
+static usbMsgLen_t rq_get_stats(usbRequest_t *rq UNUSED)
+{
+    printlnd("Get Stats");
+    stats.ser_rx_overruns = serial_ring_rx_overruns(0);
+    stats.eeprom_bytes = eeprom_q_written(0);
+    usbMsgPtr = (uchar *)&stats;    /* tell the driver which data to return */
+    return sizeof(stats);           /* tell the driver to send the statistics */
+}
+
+static usbMsgLen_t rq_reset_stats(usbRequest_t *rq UNUSED)
+{
+    printlnd("Reset Stats");
+    memset(&stats, 0, sizeof(stats));
+    serial_ring_rx_overruns(1);
+    eeprom_q_written(1);
+    return 0;
+}
+
+static usbMsgLen_t rq_set_register(usbRequest_t *rq)
+{
+    printlnd("Reg Set");
+    switch (rq->wIndex.bytes[0])
+    {
+        case REG_RSVD:
+            break;
+        case REG_DIRA:
+            DDRA = (rq->wValue.bytes[0] & ~MASK_PORTA) | (DDRA & MASK_PORTA);
+            break;
+        case REG_DIRB:
+            DDRB = (rq->wValue.bytes[0] & ~MASK_PORTB) | (DDRB & MASK_PORTB);
+            break;
+        case REG_DIRC:
+            DDRC = (rq->wValue.bytes[0] & ~MASK_PORTC) | (DDRC & MASK_PORTC);
+            break;
+        case REG_DIRD:
+            if ((rq->wValue.bytes[0] & ~MASK_PORTD) & 0b11) // PD0 & PD1 - are going to be used
+                usart_disable(); // Serial needs to be disabled
+            DDRD = (rq->wValue.bytes[0] & ~MASK_PORTD) | (DDRD & MASK_PORTD);
+            if (!((rq->wValue.bytes[0] & ~MASK_PORTD) & 0b11)) // PD0 & PD1 - no longer being used
+                usart_enable(); // Serial can be re-enabled
+            break;
+        case REG_PORTA:
+            PORTA = (rq->wValue.bytes[0] & ~MASK_PORTA) | (PORTA & MASK_PORTA);
+            break;
+        case REG_PORTB:
+            PORTB = (rq->wValue.bytes[0] & ~MASK_PORTB) | (PORTB & MASK_PORTB);
+            break;
+        case REG_PORTC:
+            PORTC = (rq->wValue.bytes[0] & ~MASK_PORTC) | (PORTC & MASK_PORTC);
+            break;
+        case REG_PORTD:
+            PORTD = (rq->wValue.bytes[0] & ~MASK_PORTD) | (PORTD & MASK_PORTD);
+            break;
+        default:
+            break;
+    }
+    return 0;
+}
+
+static usbMsgLen_t rq_get_register(usbRequest_t *rq)
+{
+    printlnd("Reg Get");
+    switch (rq->wIndex.bytes[0])
+    {
+        case REG_RSVD:
+            rq_buf[0] = 0;
+            break;
+        case REG_DIRA:
+            rq_buf[0] = DDRA & ~MASK_PINA;
+            break;
+        case REG_DIRB:
+            rq_buf[0] = DDRB & ~MASK_PINB;
+            break;
+        case REG_DIRC:
+            rq_buf[0] = DDRC & ~MASK_PINC;
+            break;
+        case REG_DIRD:
+            rq_buf[0] = DDRD & ~MASK_PIND;
+            break;
+        case REG_PORTA:
+            rq_buf[0] = PINA & ~MASK_PINA;
+            break;
+        case REG_PORTB:
+            rq_buf[0] = PINB & ~MASK_PINB;
+            break;
+        case REG_PORTC:
+            rq_buf[0] = PINC & ~MASK_PINC;
+            break;
+        case REG_PORTD:
+            rq_buf[0] = PIND & ~MASK_PIND;
+            break;
+        default:
+            rq_buf[0] = 0xFF;
+            break;
+    }
+    usbMsgPtr = rq_buf;             /* tell the driver which data to return */
+    return 1;                       /* tell the driver to send 1 byte */
+}
+
+/*
+ * Handlers indexed by the request number, in flash. Ones not built in, are
+ * left NULL, & treated as not implemented.
+ */
+static const RqHandler rq_table[] PROGMEM =
+{
+    [CUSTOM_RQ_ECHO] = rq_echo,
+    [CUSTOM_RQ_SET_LED_STATUS] = rq_set_led_status,
+    [CUSTOM_RQ_GET_LED_STATUS] = rq_get_led_status,
+    [CUSTOM_RQ_SET_MEM_RD_OFFSET] = rq_set_mem_rd_offset,
+    [CUSTOM_RQ_GET_MEM_RD_OFFSET] = rq_get_mem_rd_offset,
+    [CUSTOM_RQ_SET_MEM_WR_OFFSET] = rq_set_mem_wr_offset,
+    [CUSTOM_RQ_GET_MEM_WR_OFFSET] = rq_get_mem_wr_offset,
+    [CUSTOM_RQ_GET_MEM_SIZE] = rq_get_mem_size,
+    [CUSTOM_RQ_SET_MEM_TYPE] = rq_set_mem_type,
+    [CUSTOM_RQ_GET_MEM_TYPE] = rq_get_mem_type,
+    [CUSTOM_RQ_SET_REGISTER] = rq_set_register,
+    [CUSTOM_RQ_GET_REGISTER] = rq_get_register,
+    [CUSTOM_RQ_READ_BLOCK] = rq_read_block,
+    [CUSTOM_RQ_WRITE_BLOCK] = rq_write_block,
+    [CUSTOM_RQ_GET_MEM_WR_STATUS] = rq_get_mem_wr_status,
+    [CUSTOM_RQ_GET_FLASH_WR_STATS] = rq_get_flash_wr_stats,
+    [CUSTOM_RQ_START_MEM_CRC] = rq_start_mem_crc,
+    [CUSTOM_RQ_SET_SERIAL_LINE] = rq_set_serial_line,
+    [CUSTOM_RQ_GET_SERIAL_LINE] = rq_get_serial_line,
+#ifdef USE_GPIO
+    [CUSTOM_RQ_REG_BATCH] = rq_reg_batch,
+    [CUSTOM_RQ_GET_REG_BATCH] = rq_get_reg_batch,
+    [CUSTOM_RQ_SET_SEQ] = rq_set_seq,
+    [CUSTOM_RQ_RUN_SEQ] = rq_run_seq,
+    [CUSTOM_RQ_GET_SEQ_STATUS] = rq_get_seq_status,
+    [CUSTOM_RQ_SET_EVENTS] = rq_set_events,
+#endif
+#ifdef USE_ACQ
+    [CUSTOM_RQ_START_LA] = rq_start_la,
+    [CUSTOM_RQ_GET_LA_STATUS] = rq_get_la_status,
+    [CUSTOM_RQ_SET_PG] = rq_set_pg,
+    [CUSTOM_RQ_WRITE_PG] = rq_write_pg,
+    [CUSTOM_RQ_START_PG] = rq_start_pg,
+    [CUSTOM_RQ_GET_PG_STATUS] = rq_get_pg_status,
+    [CUSTOM_RQ_START_ADC] = rq_start_adc,
+    [CUSTOM_RQ_GET_ADC_STATUS] = rq_get_adc_status,
+#endif
+#ifdef USE_BUS
+    [CUSTOM_RQ_I2C_INIT] = rq_i2c_init,
+    [CUSTOM_RQ_I2C_XFER] = rq_i2c_xfer,
+    [CUSTOM_RQ_I2C_RESULT] = rq_i2c_result,
+    [CUSTOM_RQ_SPI_INIT] = rq_spi_init,
+    [CUSTOM_RQ_SPI_XFER] = rq_spi_xfer,
+    [CUSTOM_RQ_SPI_READ] = rq_spi_read,
+#endif
+#ifdef USE_TIMER
+    [CUSTOM_RQ_SET_PWM] = rq_set_pwm,
+    [CUSTOM_RQ_START_ICP] = rq_start_icp,
+    [CUSTOM_RQ_GET_ICP] = rq_get_icp,
+#endif
+#ifdef USE_CLCD
+    [CUSTOM_RQ_LCD_WRITE] = rq_lcd_write,
+#endif
+    [CUSTOM_RQ_GET_STATS] = rq_get_stats,
+    [CUSTOM_RQ_RESET_STATS] = rq_reset_stats,
+    [CUSTOM_RQ_ENTER_BOOTLOADER] = rq_enter_bootloader,
+    [CUSTOM_RQ_SET_SERIAL_NUMBER] = rq_set_serial_number,
+    [CUSTOM_RQ_GET_MEM_CRC] = rq_get_mem_crc,
+};
+
+/* ------------------------------------------------------------------------- */
+/* ----------------------------- USB interface ----------------------------- */
+/* ------------------------------------------------------------------------- */
+
+usbMsgLen_t usbFunctionSetup(uchar data[8])
+{
+    usbRequest_t *rq = (void *)data;
+    RqHandler handler;
+
+    if (rq->bRequest >= sizeof(rq_table) / sizeof(*rq_table))
+    {
+        return 0;
+    }
+    handler = (RqHandler)pgm_read_word(&rq_table[rq->bRequest]);
+    if (!handler)
+    {
+        return 0;   /* default for not implemented requests: return no data back to host */
+    }
+    return handler(rq);
+}
+
+/*
+ * Same as the one built into usbdrv.c, but for the remote wakeup attribute.
+ * Interface 0 has the memory endpoints (1), 1 the serial ones (2), & 2 none.
+ */
+const PROGMEM char usbDescriptorConfiguration[] = {    /* USB configuration descriptor */
+    9,          /* sizeof(usbDescriptorConfiguration): length of descriptor in bytes */
+    USBDESCR_CONFIG,    /* descriptor type */
+    USB_PROP_LENGTH(USB_CFG_DESCR_PROPS_CONFIGURATION), 0,
+                /* total length of data returned (including inlined descriptors) */
+    3,          /* number of interfaces in this configuration */
+    1,          /* index of this configuration */
+    0,          /* configuration name string index */
+#if USB_CFG_REMOTE_WAKEUP
+    (1 << 7) | USBATTR_REMOTEWAKE,      /* attributes */
+#else
+    (1 << 7),                           /* attributes */
+#endif
+    USB_CFG_MAX_BUS_POWER/2,            /* max USB current in 2mA units */
+/* interface descriptor follows inline: */
+    9,          /* sizeof(usbDescrInterface): length of descriptor in bytes */
+    USBDESCR_INTERFACE, /* descriptor type */
+    0,          /* index of this interface */
+    0,          /* alternate setting for this interface */
+    2,          /* endpoints excl 0: number of endpoint descriptors to follow */
+    USB_CFG_INTERFACE_CLASS,
+    USB_CFG_INTERFACE_SUBCLASS,
+    USB_CFG_INTERFACE_PROTOCOL,
+    0,          /* string index for interface */
+    7,          /* sizeof(usbDescrEndpoint) */
+    USBDESCR_ENDPOINT,  /* descriptor type = endpoint */
+    (char)0x81, /* IN endpoint number 1 */
+    0x03,       /* attrib: Interrupt endpoint */
+    8, 0,       /* maximum packet size */
+    USB_CFG_INTR_POLL_INTERVAL, /* in ms */
+    7,          /* sizeof(usbDescrEndpoint) */
+    USBDESCR_ENDPOINT,  /* descriptor type = endpoint */
+    (char)0x01, /* OUT endpoint number 1 */
+    0x03,       /* attrib: Interrupt endpoint */
+    8, 0,       /* maximum packet size */
+    USB_CFG_INTR_POLL_INTERVAL, /* in ms */
+/* interface descriptor follows inline: */
+    9,          /* sizeof(usbDescrInterface): length of descriptor in bytes */
+    USBDESCR_INTERFACE, /* descriptor type */
+    1,          /* index of this interface */
+    0,          /* alternate setting for this interface */
+    2,          /* endpoints excl 0: number of endpoint descriptors to follow */
+    USB_CFG_INTERFACE_CLASS,
+    USB_CFG_INTERFACE_SUBCLASS,
+    USB_CFG_INTERFACE_PROTOCOL,
+    0,          /* string index for interface */
+    7,          /* sizeof(usbDescrEndpoint) */
+    USBDESCR_ENDPOINT,  /* descriptor type = endpoint */
+    (char)(0x80 | USB_CFG_EP3_NUMBER), /* IN endpoint number 2 */
+    0x03,       /* attrib: Interrupt endpoint */
+    8, 0,       /* maximum packet size */
+    USB_CFG_INTR_POLL_INTERVAL, /* in ms */
+    7,          /* sizeof(usbDescrEndpoint) */
+    USBDESCR_ENDPOINT,  /* descriptor type = endpoint */
+    (char)(0x00 | USB_CFG_EP3_NUMBER), /* OUT endpoint number 2 */
+    0x03,       /* attrib: Interrupt endpoint */
+    8, 0,       /* maximum packet size */
+    USB_CFG_INTR_POLL_INTERVAL, /* in ms */
+/* interface descriptor follows inline: */
+    9,          /* sizeof(usbDescrInterface): length of descriptor in bytes */
+    USBDESCR_INTERFACE, /* descriptor type */
+    2,          /* index of this interface */
+    0,          /* alternate setting for this interface */
+    0,          /* endpoints excl 0: number of endpoint descriptors to follow */
+    USB_CFG_INTERFACE_CLASS,
+    USB_CFG_INTERFACE_SUBCLASS,
+    USB_CFG_INTERFACE_PROTOCOL,
+    0,          /* string index for interface */
+};
+/* Fails to compile, if the length in usbconfig.h goes out of sync */
+typedef char usb_cfg_descr_len_check[(sizeof(usbDescriptorConfiguration) ==
+                USB_PROP_LENGTH(USB_CFG_DESCR_PROPS_CONFIGURATION)) ? 1 : -1];
+
+USB_PUBLIC usbMsgLen_t usbFunctionDescriptor(usbRequest_t *rq)
+{
+    uint8_t i, c;
+
+    if ((rq->wValue.bytes[1] != USBDESCR_STRING) || (rq->wValue.bytes[0] != 3))
+    {
+        return 0;
+    }
+    for (i = 0; i < SERIAL_NUMBER_LEN; i++)
+    {
+        c = sn_pending ? sn_new[i] : eeprom_q_read_byte((uint8_t *)(SERIAL_NUMBER_ADDR + i));
+        if ((c < 0x20) || (c > 0x7E)) // Not programmed beyond
         {
-            case REG_RSVD:
-                dataBuffer[0] = 0;
-                break;
-            case REG_DIRA:
-                dataBuffer[0] = DDRA & ~MASK_PINA;
-                break;
-            case REG_DIRB:
-                dataBuffer[0] = DDRB & ~MASK_PINB;
-                break;
-            case REG_DIRC:
-                dataBuffer[0] = DDRC & ~MASK_PINC;
-                break;
-            case REG_DIRD:
-                dataBuffer[0] = DDRD & ~MASK_PIND;
-                break;
-            case REG_PORTA:
-                dataBuffer[0] = PINA & ~MASK_PINA;
-                break;
-            case REG_PORTB:
-                dataBuffer[0] = PINB & ~MASK_PINB;
-                break;
-            case REG_PORTC:
-                dataBuffer[0] = PINC & ~MASK_PINC;
-                break;
-            case REG_PORTD:
-                dataBuffer[0] = PIND & ~MASK_PIND;
-                break;
-            default:
-                dataBuffer[0] = 0xFF;
-                break;
+            break;
         }
-        usbMsgPtr = dataBuffer;         /* tell the driver which data to return */
-        return 1;                       /* tell the driver to send 1 byte */
+        sn_descr[1 + i] = c;
     }
-
-    return 0;   /* default for not implemented requests: return no data back to host */
+    if (i == 0)
+    {
+        sn_descr[1 + i++] = '0';
+    }
+    sn_descr[0] = USB_STRING_DESCRIPTOR_HEADER(i);
+    usbMsgPtr = (uchar *)sn_descr;
+    return sizeof(int) * (1 + i);
 }
 
-USB_PUBLIC void usbFunctionWriteOut(uchar *data, uchar len)
+USB_PUBLIC uchar usbFunctionRead(uchar *data, uchar len)
 {
     uchar mem_i;
 
+    mem_i = read_mem_data(mem_blk_off, data, len);
+    mem_blk_off += mem_i;
+    return mem_i; /* a short packet terminates the transfer */
+}
+
+USB_PUBLIC uchar usbFunctionWrite(uchar *data, uchar len)
+{
+    if (!rq_write) /* No request expecting data */
+    {
+        return 1;
+    }
+    return rq_write(data, len);
+}
+
+USB_PUBLIC void usbFunctionWriteOut(uchar *data, uchar len)
+{
     switch (usbRxToken)
     {
         case 1: // Save in Memory
-            if (mem_wr_off + len > mem_size)
-            {
-                len = mem_size - mem_wr_off;
-            }
-            if (len == 0)
-            {
-                break;
-            }
-            for (mem_i = 0; mem_i < len; mem_i++)
-            {
-                if (mem_type == eeprom)
-                {
-                    eeprom_write_byte((uint8_t *)(mem_start + mem_wr_off + mem_i),
-                            *(uint8_t *)(data + mem_i));
-                }
-                else if (mem_type == flash)
-                {
-                    flash_write_page_buffer[fwp_buf_off + mem_i] = *(uint8_t *)(data + mem_i);
-                    if (fwp_buf_off + mem_i == (SPM_PAGESIZE - 1))
-                    {
-                        flash_write_block((uint8_t *)(mem_start + mem_wr_off + mem_i - (SPM_PAGESIZE - 1)),
-                                flash_write_page_buffer);
-                        fwp_buf_off = -(mem_i + 1);
-                    }
-                }
-            }
-            fwp_buf_off += len;
-            mem_wr_off += len;
+            stats.ep1_out_pkts++;
+            write_mem_data(data, len);
             printlnd("Memory written");
             break;
         case 2: // Direct serial transfer
-            data[len] = 0;
-            usart_tx((char *)data);
+            stats.ep2_out_pkts++;
+            serial_ring_tx(data, len);
+            if (serial_ring_tx_free() < 8) // No room for another packet
+            {
+                usbDisableAllRequests(); // NAK any further data till the ring drains
+            }
             printlnd("Serial written");
             break;
         default:
@@ -383,15 +1231,18 @@ USB_PUBLIC void usbFunctionWriteOut(uchar *data, uchar len)
 
 int main(void)
 {
-    char ser_buf[8];
-    uint8_t ser_data_cnt = 0;
+    uint8_t ser_buf[8];
+    uint8_t ser_rx_cnt = 0; /* Received count, when last checked */
+    uint8_t ser_rx_ovf = 0; /* Timer1 overflow count, when it last changed */
+    uint32_t poll_start;
     uchar i;
 
     //odDebugInit();
-    usart_init(9600);
-    usart_tx("LDDK fw v" FW_VER "\r\n");
+    timer_init();
+    serial_ring_init(9600);
+    serial_ring_tx_str("LDDK fw v" FW_VER "\r\n");
 #ifdef USE_CLCD
-    clcd_init();
+    clcd_fb_init();
     println1("LDDK fw v" FW_VER);
 #endif
     jtag_disable();
@@ -429,6 +1280,7 @@ int main(void)
     SW_PORT_PULLUP |= (_BV(BT_BIT) | _BV(DL_BIT));
     /* Make the BT & DL switch bits as input */
     SW_PORT_DDR &= ~(_BV(BT_BIT) | _BV(DL_BIT));
+    power_init();
     printlnd("Enabling intrs");
     DBG2(0x00, (uchar *)"F", 1);
     sei();
@@ -439,23 +1291,69 @@ int main(void)
 #ifdef USE_WD
         wdt_reset();
 #endif
+        poll_start = timer_now();
         usbPoll();
+        update_stats(poll_start);
+        commit_flash_page();
+        commit_serial_number();
+        update_mem_crc();
+#ifdef USE_GPIO
+        rq_gpio_poll();
+#endif
+#ifdef USE_ACQ
+        rq_acq_poll();
+#endif
+#ifdef USE_BUS
+        rq_bus_poll();
+#endif
+        resume_requests();
+#ifdef USE_CLCD
+        clcd_fb_flush();
+#endif
+        if (boot_pending)
+        {
+            enter_bootloader();
+        }
+        if (power_bus_idle() && !fwp_pending && !sn_pending && !eeprom_q_busy()) // Let the writes complete
+        {
+            suspend();
+        }
         DBG2(0x02, (uchar *)"Z2", 2);
         if (!(SW_PORT_INPUT & _BV(BT_BIT)))
         {
-            usart_tx("Dev Drv Kit v2.1\r\n");
+            serial_ring_tx_str("Dev Drv Kit v2.1\r\n");
 #ifdef USE_CLCD
-            clcd_cls(); /* Clear LCD on switch press */
+            clcd_fb_cls(); /* Clear LCD on switch press */
             println1("Dev Drv Kit v2.1");
 #endif
         }
         DBG2(0x02, (uchar *)"Z3", 2);
-        while (usart_byte_available() && (ser_data_cnt < 8))
+        if (serial_ring_rx_count() != ser_rx_cnt) // Still receiving
         {
-            ser_buf[ser_data_cnt++] = usart_byte_rx();
+            ser_rx_cnt = serial_ring_rx_count();
+            ser_rx_ovf = (uint8_t)timer_ovf_cnt;
         }
         DBG2(0x02, (uchar *)"Z4", 2);
-        if (usbInterruptIsReady())
+        if (ep1_state == ep1_data_sending)
+        {
+            if (usbInterruptIsReady())
+            {
+                /* called after every poll of the interrupt endpoint */
+                DBG2(0x03, 0, 0);   /* debug output: interrupt data prepared */
+                send_ep1_data();
+            }
+        }
+        else if (ep1_state == ep1_data_sent)
+        {
+            if (usbInterruptIsReady())
+            {
+                /* called after every poll of the interrupt endpoint */
+                DBG2(0x03, 0, 0);   /* debug output: interrupt data prepared */
+                ep1_state = ep1_mem;
+                pre_load_mem_data(); // Resume with the memory data
+            }
+        }
+        else if (usbInterruptIsReady())
         {
             /* called after every poll of the interrupt endpoint */
             DBG2(0x03, 0, 0);   /* debug output: interrupt data prepared */
@@ -469,13 +1367,17 @@ int main(void)
             }
             pre_load_mem_data();
         }
-        if (usbInterruptIsReady3() && (ser_data_cnt))
+        /* Send a full packet, or whatever is there after the line goes idle */
+        if (usbInterruptIsReady3() && ser_rx_cnt && ((ser_rx_cnt >= 8) ||
+            ((uint8_t)((uint8_t)timer_ovf_cnt - ser_rx_ovf) >= SER_IDLE_OVFS)))
         {
             /* called after every poll of the interrupt endpoint */
             DBG2(0x04, 0, 0);   /* debug output: interrupt data prepared */
-            usbSetInterrupt3((uchar *)ser_buf, ser_data_cnt);
-            ser_data_cnt = 0;
+            usbSetInterrupt3((uchar *)ser_buf, serial_ring_rx(ser_buf, 8));
+            stats.ep3_in_pkts++;
+            ser_rx_cnt = serial_ring_rx_count();
         }
+        eeprom_q_resume(); // The writes held back by the EEPROM reads, if any
         DBG2(0x02, (uchar *)"Z5", 2);
     }
     DBG2(0x05, 0, 0);
@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) eSrijan Innovations Private Limited
+ * 
+ * Author: Anil Kumar Pugalia <anil_pugalia@eSrijan.com>
+ *
+ * Licensed under: JSL (See LICENSE file for details)
+ *
+ * ATmega16/32
+ *
+ * Pattern Generator Functions
+ */
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include "requests.h"
+#include "regs.h"
+#include "acq.h"
+#include "pg.h"
+
+#define IDX_MASK (PG_SAMPLES - 1)
+
+static volatile uint8_t *pg_port;
+static uint8_t pg_bits; /* Unmasked bits of the port */
+static uint8_t pg_loop;
+static volatile uint8_t pg_st = PG_ST_IDLE;
+/* Free running indices - head updated by the writer, & tail by the player */
+static volatile uint16_t pg_head, pg_tail;
+static uint16_t pg_loop_start;
+
+static void pg_play(void)
+{
+	if (pg_tail == pg_head)
+	{
+		if (!pg_loop || (pg_head == pg_loop_start))
+		{
+			acq_clock_stop();
+			pg_st = PG_ST_DONE;
+			return;
+		}
+		pg_tail = pg_loop_start;
+	}
+	*pg_port = (*pg_port & ~pg_bits) | (acq_buf[pg_tail & IDX_MASK] & pg_bits);
+	pg_tail++;
+}
+
+int pg_config(uint8_t reg, uint8_t loop)
+{
+	volatile uint8_t *rd_reg;
+	uint8_t wr_mask, rd_mask;
+
+	if ((reg < REG_PORTA) || !get_reg(reg, &pg_port, &wr_mask, &rd_reg, &rd_mask))
+		return -1;
+
+	pg_stop();
+	pg_bits = ~wr_mask;
+	pg_loop = loop;
+	return 0;
+}
+uint8_t pg_write(const uint8_t *data, uint8_t len)
+{
+	uint16_t head = pg_head;
+	uint8_t i;
+	uint8_t sreg;
+
+	if (len > pg_free())
+	{
+		len = pg_free();
+	}
+	for (i = 0; i < len; i++)
+	{
+		acq_buf[head++ & IDX_MASK] = data[i];
+	}
+	sreg = SREG;
+	cli();
+	pg_head = head;
+	SREG = sreg;
+	return len;
+}
+int pg_start(uint8_t cs, uint8_t ocr)
+{
+	if (!pg_port)
+		return -1;
+
+	pg_st = PG_ST_PLAYING;
+	if (acq_clock_start(cs, ocr, pg_play) == -1)
+	{
+		pg_st = PG_ST_IDLE;
+		return -1;
+	}
+	return 0;
+}
+void pg_stop(void)
+{
+	if (pg_st == PG_ST_PLAYING)
+	{
+		acq_clock_stop();
+	}
+	pg_st = PG_ST_IDLE;
+	pg_head = pg_tail = pg_loop_start = 0;
+}
+uint8_t pg_state(void)
+{
+	return pg_st;
+}
+uint16_t pg_count(void)
+{
+	uint16_t cnt;
+	uint8_t sreg = SREG;
+
+	cli();
+	cnt = pg_head - (pg_loop ? pg_loop_start : pg_tail);
+	SREG = sreg;
+	return cnt;
+}
+uint16_t pg_free(void)
+{
+	return PG_SAMPLES - pg_count();
+}
+uint8_t pg_busy(void)
+{
+	/* Only while streaming, as otherwise the space wouldn't free up */
+	return (pg_st == PG_ST_PLAYING) && !pg_loop && (pg_free() < 8);
+}
@@ -0,0 +1,39 @@
+/*
+ * Copyright (C) eSrijan Innovations Private Limited
+ * 
+ * Author: Anil Kumar Pugalia <anil_pugalia@eSrijan.com>
+ *
+ * Licensed under: JSL (See LICENSE file for details)
+ *
+ * ATmega16/32
+ *
+ * Header for Pattern Generator Functions
+ *
+ * The port values written are queued in the acquisition buffer, used as a
+ * ring, and played onto the unmasked bits of the port, one on every tick of
+ * the sampling clock. In the streaming (default) mode, the values played are
+ * freed up for further ones, & the playback stops when the ring runs empty.
+ * In the loop mode, the values written are played over & over again.
+ */
+
+#ifndef PG_H
+#define PG_H
+
+#include <avr/io.h>
+
+#include "acq.h"
+
+#define PG_SAMPLES ACQ_BUF_SIZE
+
+/* Returns 0 on success, -1 for an invalid port */
+int pg_config(uint8_t reg, uint8_t loop);
+/* Returns the number of values queued, which may be less than len, if full */
+uint8_t pg_write(const uint8_t *data, uint8_t len);
+/* Returns 0 on success, -1 for an invalid or too fast clock */
+int pg_start(uint8_t cs, uint8_t ocr);
+void pg_stop(void); /* Also empties the queue */
+uint8_t pg_state(void); /* PG_ST_* */
+uint16_t pg_count(void); /* Values queued */
+uint16_t pg_free(void); /* Values which can be queued */
+uint8_t pg_busy(void); /* Streaming with no room for another packet */
+#endif
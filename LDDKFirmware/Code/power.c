@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) eSrijan Innovations Private Limited
+ * 
+ * Author: Anil Kumar Pugalia <anil_pugalia@eSrijan.com>
+ *
+ * Licensed under: JSL (See LICENSE file for details)
+ *
+ * ATmega16/32
+ *
+ * USB Suspend & Power Down Functions
+ */
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>   /* required by usbdrv.h */
+#include <avr/sleep.h>
+#include <util/delay.h>
+
+#include "usbdrv.h"
+#include "timer.h"
+#include "power.h"
+
+#define BT_BIT 2 /* PB2 on INT2 */
+
+static volatile uint8_t bus_woke;
+static uint32_t last_active;
+#if USB_CFG_REMOTE_WAKEUP
+static uint8_t remote_wakeup_on; /* DEVICE_REMOTE_WAKEUP feature, as set by the host */
+#endif
+
+/* Level triggered & armed only while suspended, so disarmed right away */
+ISR(INT1_vect)
+{
+	GICR &= ~(1 << INT1);
+	bus_woke = 1;
+}
+
+#if USB_CFG_REMOTE_WAKEUP
+/* Called by the driver on every setup packet, ahead of its own processing */
+void power_usb_setup(uchar *data, uchar len)
+{
+	usbRequest_t *rq = (void *)data;
+
+	if ((len == 8) && (rq->bmRequestType == (USBRQ_TYPE_STANDARD | USBRQ_RCPT_DEVICE | USBRQ_DIR_HOST_TO_DEVICE)) &&
+		((rq->bRequest == USBRQ_SET_FEATURE) || (rq->bRequest == USBRQ_CLEAR_FEATURE)) &&
+		(rq->wValue.word == 1)) /* Feature 1 == DEVICE_REMOTE_WAKEUP */
+	{
+		remote_wakeup_on = (rq->bRequest == USBRQ_SET_FEATURE);
+	}
+}
+/* Called by the driver at the start of a bus reset */
+void power_usb_reset(void)
+{
+	remote_wakeup_on = 0;
+}
+static void remote_wakeup(void)
+{
+	/* Only the USB interrupt is held back, as it would trigger on our own K */
+	USB_INTR_ENABLE &= ~(1 << USB_INTR_ENABLE_BIT);
+	/* K state, i.e. D+ high & D- low for low speed, for 10ms */
+	USBOUT = (USBOUT & ~USBMASK) | (1 << USBPLUS);
+	USBDDR |= USBMASK;
+	_delay_ms(10);
+	USBDDR &= ~USBMASK;
+	USBOUT &= ~USBMASK;
+	USB_INTR_PENDING = (1 << USB_INTR_PENDING_BIT);
+	USB_INTR_ENABLE |= (1 << USB_INTR_ENABLE_BIT);
+}
+#endif
+
+void power_init(void)
+{
+	MCUCR = (MCUCR & ~((1 << ISC11) | (1 << ISC10))) | (1 << ISC11); /* Falling edge */
+	GIFR = (1 << INTF1);
+	last_active = timer_now();
+}
+uint8_t power_bus_idle(void)
+{
+	uint32_t now = timer_now();
+
+	if (GIFR & (1 << INTF1)) /* Bus activity since the last check */
+	{
+		GIFR = (1 << INTF1);
+		last_active = now;
+		return 0;
+	}
+	return ((now - last_active) >= SUSPEND_IDLE_TICKS);
+}
+void power_suspend(void)
+{
+	uint8_t ucsrb = UCSRB, acsr = ACSR, gicr = GICR, mcucsr = MCUCSR;
+
+	UCSRB = 0; /* USART off */
+	ACSR |= (1 << ACD); /* Analog comparator off */
+	MCUCR &= ~((1 << ISC11) | (1 << ISC10)); /* Low level on D- */
+	set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+	bus_woke = 0;
+	for (;;)
+	{
+		cli();
+		GIFR = (1 << INTF1);
+		GICR |= (1 << INT1);
+#if USB_CFG_REMOTE_WAKEUP
+		if (remote_wakeup_on) /* Enabled by the host */
+		{
+			MCUCSR &= ~(1 << ISC2); /* Button press, i.e. falling edge */
+			GIFR = (1 << INTF2);
+			GICR |= (1 << INT2);
+		}
+#endif
+		sleep_enable();
+		sei(); /* The instruction following sei is executed before any interrupt */
+		sleep_cpu();
+		sleep_disable();
+		if (bus_woke)
+			break;
+#if USB_CFG_REMOTE_WAKEUP
+		if (remote_wakeup_on && !(PINB & (1 << BT_BIT)))
+		{
+			remote_wakeup();
+			break;
+		}
+#endif
+	}
+
+	cli();
+	MCUCR = (MCUCR & ~((1 << ISC11) | (1 << ISC10))) | (1 << ISC11); /* Falling edge */
+	MCUCSR = (MCUCSR & ~(1 << ISC2)) | (mcucsr & (1 << ISC2));
+	GIFR = (1 << INTF1) | (1 << INTF2);
+	GICR = gicr;
+	sei();
+	ACSR = acsr;
+	UCSRB = ucsrb;
+	last_active = timer_now();
+}
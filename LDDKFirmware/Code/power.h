@@ -0,0 +1,38 @@
+/*
+ * Copyright (C) eSrijan Innovations Private Limited
+ * 
+ * Author: Anil Kumar Pugalia <anil_pugalia@eSrijan.com>
+ *
+ * Licensed under: JSL (See LICENSE file for details)
+ *
+ * ATmega16/32
+ *
+ * Header for USB Suspend & Power Down Functions
+ *
+ * The hardware interrupt of the USB driver is on D+, which does not move on
+ * the low speed keep alives (SE0), & so USB_COUNT_SOF is not usable. Instead,
+ * the falling edges on D- (INT1/PD3) flag INTF1, without the interrupt being
+ * enabled, on every packet & keep alive. No flag for SUSPEND_IDLE_TICKS means
+ * the bus is suspended. The suspend then powers down, with the USART & the
+ * analog comparator shut, till D- goes low, i.e. the host resumes or resets
+ * the bus. Everything else on the device stops as well, including the time
+ * base. With USB_CFG_REMOTE_WAKEUP, the BUTTON (PB2 on INT2) also wakes it up,
+ * signalling the host to resume, but only if the host has enabled it, with
+ * SET_FEATURE(DEVICE_REMOTE_WAKEUP), as tracked through the driver hooks
+ * (see usbconfig.h), as the driver itself does not.
+ */
+
+#ifndef POWER_H
+#define POWER_H
+
+#include <avr/io.h>
+
+#include "timer.h"
+
+#define SUSPEND_IDLE_TICKS (3000 * TIMER_TICKS_PER_US) /* 3ms, as per the USB spec */
+
+void power_init(void);
+uint8_t power_bus_idle(void);
+/* Returns on the bus resume or reset, or after signalling the remote wakeup */
+void power_suspend(void);
+#endif
@@ -0,0 +1,148 @@
+/*
+ * Copyright (C) eSrijan Innovations Private Limited
+ * 
+ * Author: Anil Kumar Pugalia <anil_pugalia@eSrijan.com>
+ *
+ * Licensed under: JSL (See LICENSE file for details)
+ *
+ * ATmega16/32
+ *
+ * Hardware PWM & Square Wave Functions
+ */
+
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+
+#include "requests.h"
+#include "pwm.h"
+
+/* Prescaler shifts, for clock select from 1, in flash */
+static const uint8_t t0_prescale_shift[] PROGMEM = { 0, 3, 6, 8, 10 };
+static const uint8_t t2_prescale_shift[] PROGMEM = { 0, 3, 5, 6, 7, 8, 10 };
+
+static uint8_t select_fast(const uint8_t *shift, uint8_t cnt, uint32_t freq, uint32_t *actual)
+/* Picks the prescaler giving the frequency closest to freq */
+{
+	uint8_t i, cs = 1;
+	uint32_t f, diff, best_diff = 0xFFFFFFFF;
+
+	for (i = 0; i < cnt; i++)
+	{
+		f = (F_CPU / 256) >> pgm_read_byte(&shift[i]);
+		diff = (f > freq) ? (f - freq) : (freq - f);
+		if (diff < best_diff)
+		{
+			best_diff = diff;
+			cs = i + 1;
+			*actual = f;
+		}
+	}
+	return cs;
+}
+static uint8_t select_toggle(const uint8_t *shift, uint8_t cnt, uint32_t freq, uint8_t *ocr, uint32_t *actual)
+/* Picks the smallest prescaler, for which the compare value fits in 8 bits */
+{
+	uint8_t i;
+	uint32_t base, div;
+
+	for (i = 0; i < cnt; i++)
+	{
+		base = (F_CPU / 2) >> pgm_read_byte(&shift[i]);
+		div = (base + freq / 2) / freq; /* Rounded (1 + OCR) */
+		if (div <= 256)
+			break;
+	}
+	if (i == cnt) /* Too low - go for the lowest */
+	{
+		i = cnt - 1;
+		div = 256;
+	}
+	else if (div == 0) /* Too high - go for the highest */
+	{
+		div = 1;
+	}
+	*ocr = div - 1;
+	*actual = ((F_CPU / 2) >> pgm_read_byte(&shift[i])) / div;
+	return i + 1;
+}
+
+int32_t pwm_set(uint8_t timer, uint8_t mode, uint32_t freq, uint8_t duty)
+{
+	const uint8_t *shift;
+	uint8_t cnt, cs, ocr, tccr;
+	uint32_t actual;
+
+	if ((timer != 0) && (timer != 2))
+		return -1;
+	if ((mode > PWM_MODE_TOGGLE) || ((mode != PWM_MODE_OFF) && (freq == 0)))
+		return -1;
+	/* OC pin being used otherwise, say PD7 by the Character LCD */
+	if (((timer == 0) && (MASK_PORTB & (1 << PB3))) || ((timer == 2) && (MASK_PORTD & (1 << PD7))))
+		return -1;
+
+	if (timer == 0)
+	{
+		shift = t0_prescale_shift;
+		cnt = sizeof(t0_prescale_shift);
+	}
+	else
+	{
+		shift = t2_prescale_shift;
+		cnt = sizeof(t2_prescale_shift);
+	}
+
+	switch (mode)
+	{
+		case PWM_MODE_FAST:
+			cs = select_fast(shift, cnt, freq, &actual);
+			ocr = duty;
+			/* Fast PWM, non-inverting. 0 still gives a 1 cycle pulse, so disconnected */
+			tccr = (1 << WGM01) | (1 << WGM00) | (duty ? (1 << COM01) : 0) | (cs << CS00);
+			break;
+		case PWM_MODE_TOGGLE:
+			cs = select_toggle(shift, cnt, freq, &ocr, &actual);
+			tccr = (1 << WGM01) | (1 << COM00) | (cs << CS00); /* CTC, toggle on match */
+			break;
+		default:
+			ocr = 0;
+			tccr = 0;
+			actual = 0;
+			break;
+	}
+
+	/* TCCR0 & TCCR2 have the same bit layout */
+	if (timer == 0)
+	{
+		TCCR0 = 0;
+		TIMSK &= ~(1 << OCIE0); /* Taken over from the sampling clock, if it was running */
+		if (tccr)
+		{
+			PORTB &= ~(1 << PB3); /* Low, whenever disconnected */
+			DDRB |= (1 << PB3);
+		}
+		else
+		{
+			DDRB &= ~(1 << PB3);
+		}
+		TCNT0 = 0;
+		OCR0 = ocr;
+		TCCR0 = tccr;
+	}
+	else
+	{
+		TCCR2 = 0;
+		if (tccr)
+		{
+			PORTD &= ~(1 << PD7);
+			DDRD |= (1 << PD7);
+		}
+		else
+		{
+			DDRD &= ~(1 << PD7);
+		}
+		TCNT2 = 0;
+		OCR2 = ocr;
+		TCCR2 = tccr;
+	}
+	return actual;
+}
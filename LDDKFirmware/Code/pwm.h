@@ -0,0 +1,32 @@
+/*
+ * Copyright (C) eSrijan Innovations Private Limited
+ * 
+ * Author: Anil Kumar Pugalia <anil_pugalia@eSrijan.com>
+ *
+ * Licensed under: JSL (See LICENSE file for details)
+ *
+ * ATmega16/32
+ *
+ * Header for Hardware PWM & Square Wave Functions
+ *
+ * The 8-bit Timer/Counter0 & 2 generate the waveform on their OC pins, i.e.
+ * OC0/PB3 (Pin 4) & OC2/PD7 (Pin 21), picking the prescaler for the frequency
+ * asked for, as Examples/dac.c & Examples/buzzer.c do at compile time:
+ * 	Fast PWM: f = F_CPU / (N * 256), with the duty cycle of duty / 256
+ * 	CTC toggle: f = F_CPU / (2 * N * (1 + OCR)), with a 50% duty cycle
+ * where N is 1, 8, 64, 256, 1024 for Timer0, & additionally 32, 128 for
+ * Timer2. Timer1 is the time base, & so not available. Timer0 is also the
+ * sampling clock, which takes it over on starting a capture or playback.
+ */
+
+#ifndef PWM_H
+#define PWM_H
+
+#include <avr/io.h>
+
+/*
+ * Returns the frequency generated in Hz, 0 if switched off, or -1 for invalid
+ * parameters, or if the timer's OC pin is protected (MASK_PORTx)
+ */
+int32_t pwm_set(uint8_t timer, uint8_t mode, uint32_t freq, uint8_t duty);
+#endif
@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) eSrijan Innovations Private Limited
+ * 
+ * Author: Anil Kumar Pugalia <anil_pugalia@eSrijan.com>
+ *
+ * Licensed under: JSL (See LICENSE file for details)
+ *
+ * ATmega16/32
+ *
+ * Register Index (REG_*) Lookup Functions
+ */
+
+#include <avr/io.h>
+
+#include "requests.h"
+#include "regs.h"
+
+uint8_t get_reg(uint8_t reg, volatile uint8_t **wr_reg, uint8_t *wr_mask,
+						volatile uint8_t **rd_reg, uint8_t *rd_mask)
+{
+	switch (reg)
+	{
+		case REG_DIRA:
+			*wr_reg = *rd_reg = &DDRA; *wr_mask = MASK_PORTA; *rd_mask = MASK_PINA;
+			break;
+		case REG_DIRB:
+			*wr_reg = *rd_reg = &DDRB; *wr_mask = MASK_PORTB; *rd_mask = MASK_PINB;
+			break;
+		case REG_DIRC:
+			*wr_reg = *rd_reg = &DDRC; *wr_mask = MASK_PORTC; *rd_mask = MASK_PINC;
+			break;
+		case REG_DIRD:
+			*wr_reg = *rd_reg = &DDRD; *wr_mask = MASK_PORTD; *rd_mask = MASK_PIND;
+			break;
+		case REG_PORTA:
+			*wr_reg = &PORTA; *rd_reg = &PINA; *wr_mask = MASK_PORTA; *rd_mask = MASK_PINA;
+			break;
+		case REG_PORTB:
+			*wr_reg = &PORTB; *rd_reg = &PINB; *wr_mask = MASK_PORTB; *rd_mask = MASK_PINB;
+			break;
+		case REG_PORTC:
+			*wr_reg = &PORTC; *rd_reg = &PINC; *wr_mask = MASK_PORTC; *rd_mask = MASK_PINC;
+			break;
+		case REG_PORTD:
+			*wr_reg = &PORTD; *rd_reg = &PIND; *wr_mask = MASK_PORTD; *rd_mask = MASK_PIND;
+			break;
+		default:
+			return 0;
+	}
+	return 1;
+}
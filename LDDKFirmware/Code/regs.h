@@ -0,0 +1,24 @@
+/*
+ * Copyright (C) eSrijan Innovations Private Limited
+ * 
+ * Author: Anil Kumar Pugalia <anil_pugalia@eSrijan.com>
+ *
+ * Licensed under: JSL (See LICENSE file for details)
+ *
+ * ATmega16/32
+ *
+ * Header for Register Index (REG_*) Lookup Functions
+ */
+
+#ifndef REGS_H
+#define REGS_H
+
+#include <avr/io.h>
+
+/*
+ * Gets the register to write & to read, along with their protection masks, for
+ * the register index. Returns 0 for an invalid register index.
+ */
+uint8_t get_reg(uint8_t reg, volatile uint8_t **wr_reg, uint8_t *wr_mask,
+						volatile uint8_t **rd_reg, uint8_t *rd_mask);
+#endif
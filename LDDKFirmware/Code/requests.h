@@ -67,15 +67,20 @@
 #define CUSTOM_RQ_SET_MEM_TYPE         8
 /* Set the memory to be accessed. Control-OUT.
  * The requested type is passed in the "wValue" field of the control
- * transfer. No OUT data is sent. Value of 0 indicates EEPROM and value of 1
- * indicates Flash. Other values are ignored. In case of successful setting,
- * all the offsets are reset.
+ * transfer. No OUT data is sent. Value of 0 indicates EEPROM, value of 1
+ * indicates Flash, value of 2 indicates SRAM (from RAMSTART), and value of 3
+ * indicates I/O registers (from 0x20, as in the data space). Other values are
+ * ignored. In case of successful setting, all the offsets are reset.
+ * SRAM & I/O registers are read only, with every 2-byte word (from an even
+ * address) read together with the interrupts masked, so that the 16-bit values
+ * are consistent. The 16-bit registers get read low byte first, as needed. UDR reads as 0, so as
+ * to not take away the received byte, and SREG has the I bit cleared.
  */
 
 #define CUSTOM_RQ_GET_MEM_TYPE         9
 /* Get the memory set to be accessed. Control-IN.
  * This control transfer involves a 1 byte data phase where the device sends
- * the current type to the host. The status is in bit 0 of the byte.
+ * the current type to the host.
  */
 
 #define CUSTOM_RQ_SET_REGISTER         10
@@ -112,6 +117,401 @@
  * Other values are ignored.
  */
 
+#define CUSTOM_RQ_READ_BLOCK           13
+/* Read a block of the selected memory. Control-IN.
+ * The offset is passed in the "wIndex" field and the number of bytes in the
+ * "wLength" field of the control transfer, which may be up to 254 bytes, i.e.
+ * a complete flash page fits in one transfer. The data phase carries the
+ * bytes read, and is cut short at the end of the memory. The read offset is
+ * not affected.
+ */
+
+#define CUSTOM_RQ_WRITE_BLOCK          14
+/* Write a block into the selected memory. Control-OUT.
+ * The offset is passed in the "wIndex" field and the number of bytes in the
+ * "wLength" field of the control transfer. The bytes are sent in the data
+ * phase and written as they arrive. A partially filled flash page is written
+ * at the end of the transfer. Bytes beyond the end of the memory are ignored.
+ * On completion, the write offset points right after the block.
+ */
+
+#define CUSTOM_RQ_GET_MEM_WR_STATUS    15
+/* Get the status of the memory writes. Control-IN.
+ * This control transfer involves a 2 byte data phase where the device sends
+ * the number of bytes still queued for the background EEPROM writes in the
+ * byte 0, and 1 in the byte 1 if all the written data (EEPROM bytes & filled
+ * up flash pages) has been committed, 0 otherwise. EEPROM bytes already
+ * having the same value are skipped, instead of being re-written.
+ */
+
+#define CUSTOM_RQ_GET_FLASH_WR_STATS   16
+/* Get the flash page write counters. Control-IN.
+ * This control transfer involves a 6 byte data phase where the device sends
+ * the number of pages committed, the number of those skipped as they had
+ * the same contents in flash already, and the number of those actually erased
+ * & written, as 3 16-bit values, each with its LSB first. If bit 0 of the low
+ * byte of "wValue" is set, the counters are reset after being sent.
+ */
+
+#define CUSTOM_RQ_START_MEM_CRC        17
+/* Start computing the CRC of a range of the selected memory. Control-OUT.
+ * The offset of the range is passed in the "wValue" field and its length in
+ * the "wIndex" field of the control transfer. The range is cut short at the
+ * end of the memory. The CRC-32 (IEEE 802.3, same as zlib's crc32) is computed
+ * in the background, between the USB polls, taking roughly 100ms for the
+ * complete flash, & is got with CUSTOM_RQ_GET_MEM_CRC. Any ongoing computation
+ * is dropped.
+ */
+
+#define CUSTOM_RQ_SET_SERIAL_LINE      18
+/* Set the line coding of the serial bridge (EP2 OUT / EP3 IN). Control-OUT.
+ * This control transfer involves a 7 byte data phase, laid out as the CDC
+ * SET_LINE_CODING one: baud rate (4 bytes, LSB first), stop bits (0: 1, 2: 2),
+ * parity (0: none, 1: odd, 2: even) & data bits (5 to 9). Out of range baud
+ * rates or data bits are ignored. The default is 9600 8N1.
+ */
+#define CUSTOM_RQ_GET_SERIAL_LINE      19
+/* Get the line coding of the serial bridge. Control-IN.
+ * This control transfer involves the same 7 byte data phase as of
+ * CUSTOM_RQ_SET_SERIAL_LINE, sent by the device.
+ */
+#define CUSTOM_RQ_REG_BATCH            20
+/* Execute a batch of register operations, back-to-back. Control-OUT.
+ * Each operation is atomic, with interrupts masked, but interrupts may come in
+ * between them. This control transfer involves a data phase of upto
+ * REG_BATCH_MAX operations, each being 4 bytes: register index (REG_*),
+ * operation (REG_OP_*), mask & value. The operation is applied on the bits in
+ * the mask, except the protected ones (MASK_PORTx / MASK_PINx), as follows:
+ * set / clear / toggle them, write them from the value, or read them. The
+ * value is used only by the write. Operations on invalid register indices are
+ * ignored, with their reads returning 0xFF.
+ */
+#define CUSTOM_RQ_GET_REG_BATCH        21
+/* Get the results of the last batch of register operations. Control-IN.
+ * This control transfer involves a data phase where the device sends one byte
+ * per read operation of the last CUSTOM_RQ_REG_BATCH, in their order.
+ */
+#define CUSTOM_RQ_SET_SEQ              22
+/* Load a sequence into the sequencer's RAM slot. Control-OUT.
+ * This control transfer involves a data phase of upto 64 bytes of a byte code
+ * program of SEQ_OP_* instructions, each followed by its operands. The rest of
+ * the slot is filled with SEQ_OP_END.
+ */
+#define CUSTOM_RQ_RUN_SEQ              23
+/* Run the sequence. Control-OUT.
+ * If bit 1 of the "wValue" field of the control transfer is set, the sequence
+ * is first loaded (upto 64 bytes) from the EEPROM offset passed in the "wIndex"
+ * field, otherwise it is run from the RAM slot. If bit 0 is set, it runs with
+ * interrupts masked, for exact timing, except during the waits & at the end of
+ * each loop pass, so as to let the USB in. A sequence whose worst case run time
+ * (taking each wait in full, & each loop for its count) is beyond SEQ_MAX_US,
+ * is not run at all. The bytes emitted by the sequence (upto 32)
+ * are then sent over the interrupt IN endpoint 1, in place of the memory data,
+ * with a short (possibly zero length) packet marking the end.
+ */
+#define CUSTOM_RQ_GET_SEQ_STATUS       24
+/* Get the status of the last sequence run. Control-IN.
+ * This control transfer involves a 2 byte data phase where the device sends
+ * the status (SEQ_ST_*) & the number of bytes emitted.
+ */
+
+/* Defines for the sequencer instructions & their operands */
+#define SEQ_OP_END 0 /* - */
+#define SEQ_OP_WRITE 1 /* register index, mask, value: write the masked bits */
+#define SEQ_OP_READ 2 /* register index, mask: read the masked bits */
+#define SEQ_OP_EMIT 3 /* -: emit the last read */
+#define SEQ_OP_WAIT_US 4 /* us (2 bytes, LSB first): wait */
+#define SEQ_OP_WAIT_PIN 5 /* register index, mask, value, timeout us (2 bytes) */
+#define SEQ_OP_LOOP 6 /* count (0 for 256): repeat till the matching next */
+#define SEQ_OP_NEXT 7 /* - */
+
+/* Defines for the sequencer status */
+#define SEQ_ST_IDLE 0
+#define SEQ_ST_RUNNING 1
+#define SEQ_ST_DONE 2
+#define SEQ_ST_TIMEOUT 3 /* SEQ_OP_WAIT_PIN timed out */
+#define SEQ_ST_ERROR 4 /* Invalid instruction, register index, nesting or operands */
+#define SEQ_ST_TOO_LONG 5 /* Beyond SEQ_MAX_US, as worked out upfront, or as run */
+
+#define SEQ_MAX_US 20000 /* Longest run, keeping the USB serviced in time */
+#define CUSTOM_RQ_START_LA             25
+/* Start a logic analyzer capture. Control-OUT.
+ * This control transfer involves an 8 byte data phase: register index of the
+ * port to sample (REG_PORTA to REG_PORTD), Timer0 clock select (2 to 5) &
+ * compare value setting the sampling period, trigger type (LA_TRIG_*),
+ * trigger mask & value, and the number of pre-trigger samples (2 bytes, LSB
+ * first). The unmasked bits of the port are sampled into a 512 sample buffer,
+ * at upto 50 KHz, with a jitter of the USB interrupt. Once the capture
+ * completes, it is sent over the interrupt IN endpoint 1, in place of the
+ * memory data, run length encoded as pairs of the sample & its repeat count -
+ * 1, with a short (possibly zero length) packet marking the end. Invalid
+ * settings leave the capture idle.
+ */
+#define CUSTOM_RQ_GET_LA_STATUS        26
+/* Get the logic analyzer status. Control-IN.
+ * If bit 0 of the "wValue" field of the control transfer is set, the ongoing
+ * capture is aborted first. This control transfer involves a 3 byte data
+ * phase where the device sends the state (LA_ST_*) & the number of samples
+ * captured (2 bytes, LSB first).
+ */
+
+/* Defines for the logic analyzer triggers & states */
+#define LA_TRIG_NONE 0 /* Trigger right away */
+#define LA_TRIG_LEVEL 1 /* Trigger on the masked bits being at the value */
+#define LA_TRIG_EDGE 2 /* Trigger on the masked bits changing to the value */
+
+#define LA_ST_IDLE 0
+#define LA_ST_ARMED 1
+#define LA_ST_TRIGGERED 2
+#define LA_ST_DONE 3
+#define CUSTOM_RQ_SET_PG               27
+/* Set up the pattern generator. Control-OUT.
+ * The register index of the port to play onto (REG_PORTA to REG_PORTD) is
+ * passed in the low byte of the "wIndex" field of the control transfer. If
+ * bit 0 of its high byte is set, the values are played in a loop, otherwise
+ * they are streamed, i.e. freed up as played. Any playback is stopped, & the
+ * queue is emptied. It shares the 512 byte buffer with the logic analyzer,
+ * so it also aborts any capture.
+ */
+#define CUSTOM_RQ_WRITE_PG             28
+/* Queue port values to be played. Control-OUT.
+ * The data phase of this control transfer carries the values. While streaming,
+ * the data is NAKed till there is space for it. Otherwise, the values which
+ * do not fit in are dropped, & counted in the status.
+ */
+#define CUSTOM_RQ_START_PG             29
+/* Start playing the queued values. Control-OUT.
+ * The Timer0 clock select (2 to 5) & compare value, setting the period, are
+ * passed in the low & high bytes of the "wValue" field of the control
+ * transfer, as for the logic analyzer. The playback has a jitter of the USB
+ * interrupt.
+ */
+#define CUSTOM_RQ_GET_PG_STATUS        30
+/* Get the pattern generator status. Control-IN.
+ * If bit 0 of the "wValue" field of the control transfer is set, the playback
+ * is stopped & the queue emptied first. This control transfer involves a 7
+ * byte data phase where the device sends the state (PG_ST_*), the number of
+ * values queued, the space left & the number of values dropped, as not fitting
+ * in, since the set up or the last stop (2 bytes each, LSB first, with the last
+ * one saturating at 0xFFFF).
+ */
+
+/* Defines for the pattern generator states */
+#define PG_ST_IDLE 0
+#define PG_ST_PLAYING 1
+#define PG_ST_DONE 2 /* Ran out of the values */
+#define CUSTOM_RQ_I2C_INIT             31
+/* Initialize the I2C master, on PC0 (SCL) & PC1 (SDA). Control-OUT.
+ * If bit 0 of the "wValue" field of the control transfer is set, the bus runs
+ * in the fast mode (400KHz), otherwise in the standard mode (100KHz), which is
+ * also the default on the first transaction. PB7 (PGM LED) indicates errors.
+ */
+#define CUSTOM_RQ_I2C_XFER             32
+/* Run a batch of I2C transactions. Control-OUT.
+ * The data phase of this control transfer (upto 64 bytes) carries the
+ * transactions, each laid out as: 7-bit slave address, write length, read
+ * length, followed by the bytes to write. A transaction with both the lengths
+ * non-zero is a write followed by a read with a repeated start. With both of
+ * them zero, it just addresses the slave, i.e. probes it. The transactions are
+ * run back-to-back from the main loop, after the data phase, with the further
+ * requests NAKed till they are done.
+ */
+#define CUSTOM_RQ_I2C_RESULT           33
+/* Get the results of the last batch of I2C transactions. Control-IN.
+ * This control transfer involves a data phase (upto 64 bytes) where the
+ * device sends for each transaction, a status (0 for success, I2C_ST_FAIL
+ * otherwise), followed by the bytes read. Transactions whose results would not
+ * fit in are not run, & so have no results.
+ */
+
+#define I2C_ST_FAIL 0xFF
+#define CUSTOM_RQ_SPI_INIT             34
+/* Initialize (or shut) the SPI master. Control-IN.
+ * The clock divisor select (0 to 6 for F_CPU / 2, 4, 8, ..., 128) & the mode
+ * (bits 1-0: SPI mode, bit 2: LSB first) are passed in the low & high bytes of
+ * the "wValue" field of the control transfer, and the chip select pin as the
+ * register index (REG_PORTA to REG_PORTD) & the bit number in the low & high
+ * bytes of the "wIndex" field. A chip select pin protected by MASK_PORTx, or
+ * any other invalid setting, shuts the SPI master. It uses PB5 (MOSI), PB6
+ * (MISO) & PB7 (SCK, also the PGM LED). This control transfer involves a 1
+ * byte data phase where the device sends the status (SPI_ST_OK or
+ * SPI_ST_INVALID).
+ */
+#define CUSTOM_RQ_SPI_XFER             35
+/* Do a full-duplex SPI transfer. Control-OUT.
+ * The data phase of this control transfer (upto 64 bytes) carries the bytes
+ * to send, which are exchanged as they arrive, with the chip select driven low.
+ * If bit 0 of the "wValue" field is set, the chip select is kept low after the
+ * transfer, so as to continue it with the next one, thus allowing transfers of
+ * any length. If the SPI is not the master, as not initialized, or as dropped
+ * out on the DOWNLOAD switch (PB4, SS) being pressed, the bytes are dropped,
+ * with the status set to SPI_ST_NO_MASTER, till initialized again.
+ */
+#define CUSTOM_RQ_SPI_READ             36
+/* Get the bytes received in the last SPI transfer. Control-IN.
+ * This control transfer involves a data phase (upto 65 bytes) where the
+ * device sends the status (SPI_ST_*), followed by the bytes received, in place
+ * of the ones sent, i.e. only those exchanged before any failure.
+ */
+
+#define SPI_ST_OK 0
+#define SPI_ST_INVALID 1 /* Invalid settings, & so shut */
+#define SPI_ST_NO_MASTER 2 /* Not initialized, or dropped out of the master mode */
+#define CUSTOM_RQ_START_ADC            37
+/* Start streaming ADC samples. Control-OUT.
+ * The Timer0 clock select (2 to 5) & compare value, setting the sampling
+ * period, are passed in the low & high bytes of the "wValue" field of the
+ * control transfer, as for the logic analyzer, though limited to about 9.6 KHz.
+ * That is only till the buffer fills up though, as the samples are sent at
+ * about 800 bytes a second (8 bytes every 10ms), i.e. sustained, about 800
+ * samples a second if 8-bit, or 640 if 10-bit, shared by all the channels.
+ * The bit mask of the channels (ADC0-7 on PA0-7) to be converted in turn, is
+ * passed in the low byte of the "wIndex" field. If bit 0 of its high byte is
+ * set, the samples are 10-bit, packed as a bit stream LSB first, i.e. 4
+ * samples in 5 bytes, otherwise they are 8-bit (the higher ones). The samples
+ * are sent over the interrupt IN endpoint 1 in place of the memory data, 8
+ * bytes a packet, till stopped, when a short (possibly zero length) packet
+ * marks the end. It shares the 512 byte buffer with the logic analyzer & the
+ * pattern generator, so it aborts them.
+ */
+#define CUSTOM_RQ_GET_ADC_STATUS       38
+/* Get the ADC streaming status. Control-IN.
+ * If bit 0 of the "wValue" field of the control transfer is set, the streaming
+ * is stopped first. This control transfer involves a 3 byte data phase where
+ * the device sends the state (ADC_ST_*) & the number of samples dropped for
+ * the lack of space (2 bytes, LSB first).
+ */
+
+/* Defines for the ADC streaming states */
+#define ADC_ST_IDLE 0
+#define ADC_ST_RUNNING 1
+#define ADC_ST_STOPPED 2 /* Yet to send the last samples */
+#define CUSTOM_RQ_GET_STATS            39
+/* Get the firmware statistics. Control-IN.
+ * This control transfer involves a 22 byte data phase where the device sends
+ * the following counters, each LSB first, the 16-bit ones wrapping around:
+ *   Main loop iterations per second (2 bytes)
+ *   Worst & average (over the last second) usbPoll() duration, in CPU cycles
+ *   (2 bytes each), the worst one saturating at 65535
+ *   Interrupt IN packets taken on EP1 & EP3 (2 bytes each)
+ *   Interrupt OUT packets received on EP1 & EP2 (2 bytes each)
+ *   Serial bytes lost in receive (2 bytes)
+ *   EEPROM bytes written, not counting the ones skipped as unchanged (2 bytes)
+ *   Flash bytes erased & written (4 bytes)
+ */
+#define CUSTOM_RQ_RESET_STATS          40
+/* Reset the counters of the firmware statistics. Control-OUT. */
+
+#define CUSTOM_RQ_SET_EVENTS           41
+/* Watch input bits for changes. Control-OUT.
+ * The register index of the port (REG_PORTA to REG_PORTD) is passed in the
+ * low byte of the "wIndex" field of the control transfer, and the bit mask of
+ * the bits to watch in the low byte of the "wValue" field, replacing the
+ * earlier one for the port. 0 stops watching the port. The bits are scanned
+ * every millisecond, with PB2 (the BUTTON) also caught right away on INT2.
+ * While any bits are watched, the interrupt IN endpoint 1 sends, in place of
+ * the memory data, an 8 byte packet for each change, & NAKs otherwise. The
+ * packet has the register index, new value of the watched bits, bits changed,
+ * number of changes coalesced, & the time stamp (4 bytes, LSB first, in CPU
+ * cycles). Changes, till the host takes the previous event of the port, are
+ * coalesced into it. Once nothing is watched, a zero length packet marks the
+ * end.
+ */
+#define CUSTOM_RQ_SET_PWM              42
+/* Generate a PWM or a square wave on a timer's OC pin. Control-IN.
+ * The low nibble of the low byte of the "wIndex" field of the control transfer
+ * has the timer number (0 for OC0/PB3, or 2 for OC2/PD7), its bits 4 & 5 the
+ * mode (PWM_MODE_*), & its bit 7 set if the frequency is in KHz, rather than
+ * in Hz. The "wValue" field has the frequency, & the high byte of the "wIndex"
+ * field the duty cycle (in 1/256ths) for the fast PWM. The prescaler is picked
+ * on the device, from the few possible for the fast PWM, & the closest
+ * frequency generated. The square wave can go from about 30 Hz to 8 MHz.
+ * Timer0 is also the sampling clock, & so any capture, playback or ADC
+ * streaming is stopped for it. Timer2 is not available with the Character LCD,
+ * as PD7 is one of its data lines.
+ * This control transfer involves a 4 byte data phase where the device sends
+ * the frequency generated in Hz (LSB first), 0 if switched off. Nothing is
+ * sent for invalid parameters.
+ */
+
+/* Defines for the PWM modes */
+#define PWM_MODE_OFF 0
+#define PWM_MODE_FAST 1
+#define PWM_MODE_TOGGLE 2
+
+#define CUSTOM_RQ_START_ICP            43
+/* Start or stop the input capture measurement on ICP1/PD6. Control-OUT.
+ * The mode (ICP_MODE_*) is passed in the low byte of the "wValue" field of the
+ * control transfer, & bit 0 of its high byte enables the noise canceler, i.e.
+ * the edge has to be stable for 4 CPU cycles. The period mode captures the
+ * rising edges only, & the pulse mode both, for the high times as well. It is
+ * not available with the Character LCD, as PD6 is one of its data lines.
+ */
+#define CUSTOM_RQ_GET_ICP              44
+/* Get the input capture measurement. Control-IN.
+ * This control transfer involves a 14 byte data phase where the device sends
+ * the average period, the average high time (4 bytes each, in CPU cycles,
+ * i.e. 62.5ns at 16MHz), the number of periods averaged (2 bytes), & the count
+ * of pulses since the start (4 bytes), all LSB first. The averaging starts
+ * afresh after every get.
+ */
+
+/* Defines for the input capture modes */
+#define ICP_MODE_OFF 0
+#define ICP_MODE_PERIOD 1
+#define ICP_MODE_PULSE 2
+
+#define CUSTOM_RQ_LCD_WRITE            45
+/* Write text onto the character LCD. Control-OUT.
+ * Only with the firmware built with USE_CLCD. This control transfer involves
+ * a data phase with the text stream, written into the on-device framebuffer
+ * of the 32 LCD cells (0-15 on the first line, & 16-31 on the second), with
+ * the characters (0x20 onwards) at the cursor, which then moves right, and the
+ * following control characters:
+ * 	'\b': Move the cursor one left
+ * 	'\r': Move the cursor to the start of its line
+ * 	'\n': Move the cursor to the start of the other line
+ * 	'\f': Clear the display & move the cursor to 0
+ * 	CLCD_FB_MOVE, position: Move the cursor to the position (0-31)
+ * The cursor state carries on across the transfers. The changed cells are
+ * then written onto the LCD in the background, one per main loop.
+ */
+
+/* Defines for the LCD text stream control characters */
+#define CLCD_FB_MOVE 0x10
+
+#define CUSTOM_RQ_ENTER_BOOTLOADER     46
+/* Reset into the bootloader, for a firmware upgrade. Control-OUT.
+ * The device completes any pending EEPROM & flash writes, disconnects from the
+ * USB, & resets, to come up in the bootloader, as if the Download switch was
+ * pressed, till the new firmware is downloaded.
+ */
+
+#define CUSTOM_RQ_SET_SERIAL_NUMBER    47
+/* Program the USB serial number of the device. Control-OUT.
+ * This control transfer involves a data phase with upto SERIAL_NUMBER_LEN
+ * printable ASCII characters, stored in the EEPROM just after the part
+ * accessible as memory. It shows up in the serial number string descriptor
+ * from the next enumeration. Without any, the serial number is "0".
+ */
+#define SERIAL_NUMBER_LEN 8
+
+#define CUSTOM_RQ_GET_MEM_CRC          48
+/* Get the CRC started with CUSTOM_RQ_START_MEM_CRC. Control-IN.
+ * This control transfer involves a 5 byte data phase where the device sends
+ * 1 in the byte 0 if it is still being computed, 0 otherwise, followed by the
+ * CRC-32 (of the range so far, if still being computed), with its LSB first.
+ */
+
+/* Defines for the register batch operations */
+#define REG_OP_SET 0
+#define REG_OP_CLEAR 1
+#define REG_OP_TOGGLE 2
+#define REG_OP_WRITE 3
+#define REG_OP_READ 4
+
+#define REG_BATCH_MAX 16
+
 /* Defines for the register indices */
 #define REG_RSVD 0
 #define REG_DIRA 1
@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) eSrijan Innovations Private Limited
+ *
+ * Author: Anil Kumar Pugalia <anil_pugalia@eSrijan.com>
+ *
+ * Licensed under: JSL (See LICENSE file for details)
+ *
+ * ATmega16/32
+ *
+ * Header for the Custom Request Handlers
+ *
+ * usbFunctionSetup() dispatches a request through a table indexed by its
+ * number, to the handler registered for it. Apart from the core ones in main.c,
+ * handlers come from the request modules, each built in with its USE_* flag.
+ * A handler with a data phase sets rq_write, for usbFunctionWrite() to pass on
+ * the data to, & returns USB_NO_MSG.
+ *
+ * The data of a request acted upon only once it is complete (the serial line
+ * coding, the logic analyzer config, the register & I2C batches) is received
+ * into a scratch buffer shared between them. Their results are kept apart.
+ */
+
+#ifndef RQ_H
+#define RQ_H
+
+#include <avr/io.h>
+
+#include "usbdrv.h"
+#ifdef USE_CLCD
+#include "clcd_fb.h"
+#endif
+
+#define RQ_BUF_SIZE 14 /* Largest reply from rq_buf, the ICP result */
+#define UNUSED __attribute__((unused)) /* for the handlers not needing the request */
+
+typedef usbMsgLen_t (*RqHandler)(usbRequest_t *rq);
+/* Returns 1, once all the data expected is received */
+typedef uchar (*RqWriter)(uchar *data, uchar len);
+/* Fills upto 8 bytes to send, less marking the end, or returns more if not ready */
+typedef uint8_t (*Ep1Filler)(uint8_t *buf);
+
+#ifdef USE_CLCD
+/* Through the framebuffer, so as to not hold up the USB */
+#define println1(str) clcd_fb_println(0, str)
+#if (DEBUG_LEVEL > 0)
+#define println2(str) clcd_fb_println(1, str)
+#define printlnd(str) println2(str)
+#else
+#define printlnd(str)
+#endif
+#else
+#define printlnd(str)
+#endif
+
+#if defined(USE_GPIO) || defined(USE_BUS)
+#define RQ_SCRATCH_SIZE 64 /* Largest user, the register or the I2C batch */
+#else
+#define RQ_SCRATCH_SIZE 8 /* Largest user, the logic analyzer config */
+#endif
+
+/* From main.c */
+extern uchar rq_buf[RQ_BUF_SIZE]; /* Reply buffer, valid even after the handler returns */
+extern RqWriter rq_write; /* Receiver of the ongoing request's data */
+extern uint8_t rq_scratch[RQ_SCRATCH_SIZE]; /* Valid only during a request */
+/* Sends over the interrupt IN endpoint 1, in place of the memory data */
+void start_ep1_data(Ep1Filler fill);
+void start_ep1_buf(uint8_t *data, unsigned len);
+uint8_t ep1_sending(Ep1Filler fill);
+/* Returns 1, if the control endpoint has nothing left to send */
+uint8_t usb_ctrl_idle(void);
+
+#ifdef USE_GPIO
+/* From rq_gpio.c: Register batches, micro-sequencer, change events */
+usbMsgLen_t rq_reg_batch(usbRequest_t *rq);
+usbMsgLen_t rq_get_reg_batch(usbRequest_t *rq);
+usbMsgLen_t rq_set_seq(usbRequest_t *rq);
+usbMsgLen_t rq_run_seq(usbRequest_t *rq);
+usbMsgLen_t rq_get_seq_status(usbRequest_t *rq);
+usbMsgLen_t rq_set_events(usbRequest_t *rq);
+/* Runs a sequence, once its request is done. Called from the main loop */
+void rq_gpio_poll(void);
+#endif
+
+#ifdef USE_ACQ
+/* From rq_acq.c: Logic analyzer, pattern generator, ADC streaming */
+usbMsgLen_t rq_start_la(usbRequest_t *rq);
+usbMsgLen_t rq_get_la_status(usbRequest_t *rq);
+usbMsgLen_t rq_set_pg(usbRequest_t *rq);
+usbMsgLen_t rq_write_pg(usbRequest_t *rq);
+usbMsgLen_t rq_start_pg(usbRequest_t *rq);
+usbMsgLen_t rq_get_pg_status(usbRequest_t *rq);
+usbMsgLen_t rq_start_adc(usbRequest_t *rq);
+usbMsgLen_t rq_get_adc_status(usbRequest_t *rq);
+/* Sends a completed capture. Called from the main loop */
+void rq_acq_poll(void);
+/* Returns 1 if there is no room for more pattern generator values */
+uint8_t rq_acq_busy(void);
+/* Stops all the acquisition, say to take over Timer0 */
+void rq_acq_stop(void);
+#endif
+
+#ifdef USE_BUS
+/* From rq_bus.c: I2C & SPI bridges */
+usbMsgLen_t rq_i2c_init(usbRequest_t *rq);
+usbMsgLen_t rq_i2c_xfer(usbRequest_t *rq);
+usbMsgLen_t rq_i2c_result(usbRequest_t *rq);
+usbMsgLen_t rq_spi_init(usbRequest_t *rq);
+usbMsgLen_t rq_spi_xfer(usbRequest_t *rq);
+usbMsgLen_t rq_spi_read(usbRequest_t *rq);
+/* Runs an I2C batch, once its request is done. Called from the main loop */
+void rq_bus_poll(void);
+/* Returns 1 till the I2C batch received is run */
+uint8_t rq_bus_busy(void);
+#endif
+
+#ifdef USE_TIMER
+/* From rq_timer.c: PWM & input capture */
+usbMsgLen_t rq_set_pwm(usbRequest_t *rq);
+usbMsgLen_t rq_start_icp(usbRequest_t *rq);
+usbMsgLen_t rq_get_icp(usbRequest_t *rq);
+#endif
+
+#ifdef USE_CLCD
+/* From rq_lcd.c: Character LCD text */
+usbMsgLen_t rq_lcd_write(usbRequest_t *rq);
+#endif
+#endif
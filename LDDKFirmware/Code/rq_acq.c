@@ -0,0 +1,223 @@
+/*
+ * Copyright (C) eSrijan Innovations Private Limited
+ *
+ * Author: Anil Kumar Pugalia <anil_pugalia@eSrijan.com>
+ *
+ * Licensed under: JSL (See LICENSE file for details)
+ *
+ * ATmega16/32
+ *
+ * Acquisition Request Handlers: Logic analyzer, pattern generator, ADC streaming
+ *
+ * All of these share the acquisition buffer & clock, & so starting one stops
+ * the others.
+ */
+
+#include <avr/io.h>
+
+#include "requests.h"
+#include "rq.h"
+#include "la.h"
+#include "pg.h"
+#include "adc_stream.h"
+
+#define LA_CFG_SIZE 8
+#if (LA_CFG_SIZE > RQ_SCRATCH_SIZE)
+#error "rq_scratch too small for the logic analyzer config"
+#endif
+
+#define la_cfg (rq_scratch) /* Logic analyzer config being received */
+static uint8_t la_cfg_len;
+static uint8_t la_running; /* Capture started & yet to be sent */
+
+static unsigned pg_wr_len; /* Bytes remaining of the values being written */
+static uint16_t pg_dropped; /* Values not fitting in, since the set up */
+
+static void la_halt(void)
+{
+	la_stop();
+	la_running = 0;
+}
+
+static void start_la(void)
+{
+	pg_stop(); // Shares the buffer & the clock
+	adc_stream_stop();
+	la_running = (la_start(la_cfg[0], la_cfg[1], la_cfg[2], la_cfg[3], la_cfg[4],
+							la_cfg[5], la_cfg[6] | (la_cfg[7] << 8)) == 0);
+}
+
+static uchar la_cfg_write(uchar *data, uchar len)
+{
+	for (; len && (la_cfg_len < LA_CFG_SIZE); len--)
+	{
+		la_cfg[la_cfg_len++] = *data++;
+	}
+	if (la_cfg_len < LA_CFG_SIZE)
+	{
+		return 0; /* expecting more data */
+	}
+	start_la();
+	printlnd("LA started");
+	return 1;
+}
+
+usbMsgLen_t rq_start_la(usbRequest_t *rq)
+{
+	printlnd("LA Start");
+	rq_write = la_cfg_write;
+	la_cfg_len = 0;
+	if (rq->wLength.word != LA_CFG_SIZE)
+	{
+		return 0;
+	}
+	return USB_NO_MSG; /* use usbFunctionWrite() to receive the data */
+}
+
+usbMsgLen_t rq_get_la_status(usbRequest_t *rq)
+{
+	uint16_t cnt;
+
+	printlnd("LA Status");
+	if (rq->wValue.bytes[0] & 1)
+	{
+		la_halt();
+	}
+	cnt = la_count();
+	rq_buf[0] = la_state();
+	rq_buf[1] = cnt & 0xFF;
+	rq_buf[2] = (cnt >> 8) & 0xFF;
+	usbMsgPtr = rq_buf;
+	return 3;
+}
+
+usbMsgLen_t rq_set_pg(usbRequest_t *rq)
+{
+	printlnd("PG Set");
+	la_halt(); // Shares the buffer & the clock
+	adc_stream_stop();
+	pg_config(rq->wIndex.bytes[0], rq->wIndex.bytes[1] & 1);
+	pg_dropped = 0;
+	return 0;
+}
+
+static uchar pg_values_write(uchar *data, uchar len)
+{
+	uint8_t queued;
+
+	if (len > pg_wr_len)
+	{
+		len = pg_wr_len;
+	}
+	queued = pg_write(data, len); // Whatever doesn't fit in is dropped, & counted
+	if (pg_dropped <= 0xFFFF - (len - queued))
+	{
+		pg_dropped += len - queued;
+	}
+	else
+	{
+		pg_dropped = 0xFFFF;
+	}
+	pg_wr_len -= len;
+	if (pg_busy()) // No room for another packet
+	{
+		usbDisableAllRequests(); // NAK any further data till the values are played
+	}
+	return (pg_wr_len == 0);
+}
+
+usbMsgLen_t rq_write_pg(usbRequest_t *rq)
+{
+	printlnd("PG Write");
+	rq_write = pg_values_write;
+	pg_wr_len = rq->wLength.word;
+	if (pg_wr_len == 0)
+	{
+		return 0;
+	}
+	return USB_NO_MSG; /* use usbFunctionWrite() to receive the data */
+}
+
+usbMsgLen_t rq_start_pg(usbRequest_t *rq)
+{
+	printlnd("PG Start");
+	la_halt(); // Shares the clock
+	adc_stream_stop();
+	pg_start(rq->wValue.bytes[0], rq->wValue.bytes[1]);
+	return 0;
+}
+
+usbMsgLen_t rq_get_pg_status(usbRequest_t *rq)
+{
+	uint16_t cnt;
+
+	printlnd("PG Status");
+	if (rq->wValue.bytes[0] & 1)
+	{
+		pg_stop();
+		pg_dropped = 0;
+	}
+	cnt = pg_count();
+	rq_buf[0] = pg_state();
+	rq_buf[1] = cnt & 0xFF;
+	rq_buf[2] = (cnt >> 8) & 0xFF;
+	cnt = pg_free();
+	rq_buf[3] = cnt & 0xFF;
+	rq_buf[4] = (cnt >> 8) & 0xFF;
+	rq_buf[5] = pg_dropped & 0xFF;
+	rq_buf[6] = (pg_dropped >> 8) & 0xFF;
+	usbMsgPtr = rq_buf;
+	return 7;
+}
+
+usbMsgLen_t rq_start_adc(usbRequest_t *rq)
+{
+	printlnd("ADC Start");
+	la_halt(); // Shares the buffer & the clock
+	pg_stop();
+	if (adc_stream_start(rq->wValue.bytes[0], rq->wValue.bytes[1],
+							rq->wIndex.bytes[0], rq->wIndex.bytes[1] & 1) == 0)
+	{
+		start_ep1_data(adc_stream_read);
+	}
+	return 0;
+}
+
+usbMsgLen_t rq_get_adc_status(usbRequest_t *rq)
+{
+	uint16_t cnt;
+
+	printlnd("ADC Status");
+	if (rq->wValue.bytes[0] & 1)
+	{
+		adc_stream_stop();
+	}
+	cnt = adc_stream_overruns();
+	rq_buf[0] = adc_stream_state();
+	rq_buf[1] = cnt & 0xFF;
+	rq_buf[2] = (cnt >> 8) & 0xFF;
+	usbMsgPtr = rq_buf;
+	return 3;
+}
+
+void rq_acq_poll(void)
+{
+	if (!la_running || (la_state() != LA_ST_DONE))
+	{
+		return;
+	}
+	la_running = 0;
+	start_ep1_data(la_read);
+}
+
+uint8_t rq_acq_busy(void)
+{
+	return pg_busy();
+}
+
+void rq_acq_stop(void)
+{
+	la_halt();
+	pg_stop();
+	adc_stream_stop();
+}
@@ -0,0 +1,176 @@
+/*
+ * Copyright (C) eSrijan Innovations Private Limited
+ *
+ * Author: Anil Kumar Pugalia <anil_pugalia@eSrijan.com>
+ *
+ * Licensed under: JSL (See LICENSE file for details)
+ *
+ * ATmega16/32
+ *
+ * Bus Request Handlers: I2C & SPI bridges
+ */
+
+#include <avr/io.h>
+#include <string.h>
+
+#include "requests.h"
+#include "rq.h"
+#include "i2c_bridge.h"
+#include "spi_bridge.h"
+
+#if (I2C_BATCH_SIZE > RQ_SCRATCH_SIZE)
+#error "rq_scratch too small for the I2C batch"
+#endif
+
+#define i2c_batch (rq_scratch)
+static uint8_t i2c_batch_len; /* Bytes received of the batch */
+static uint8_t i2c_batch_size; /* Bytes expected in the batch */
+static uint8_t i2c_pending; /* Batch received, to be run from the main loop */
+static uint8_t i2c_res[I2C_BATCH_SIZE];
+static uint8_t i2c_res_len;
+
+/* Status (SPI_ST_*), followed by the bytes to send, exchanged with those received */
+static uint8_t spi_buf[1 + SPI_BUF_SIZE];
+static uint8_t spi_len; /* Bytes exchanged */
+static uint8_t spi_size; /* Bytes remaining to be received */
+static uint8_t spi_keep_selected;
+
+usbMsgLen_t rq_i2c_init(usbRequest_t *rq)
+{
+	printlnd("I2C Init");
+	i2c_bridge_init(rq->wValue.bytes[0] & 1);
+	return 0;
+}
+
+static uchar i2c_batch_write(uchar *data, uchar len)
+{
+	for (; len && (i2c_batch_len < i2c_batch_size); len--)
+	{
+		i2c_batch[i2c_batch_len++] = *data++;
+	}
+	if (i2c_batch_len < i2c_batch_size)
+	{
+		return 0; /* expecting more data */
+	}
+	/*
+	 * The batch takes milliseconds on the bus, too long for an interrupt
+	 * context. So, hold off the requests (& the batch in the scratch buffer)
+	 * till it is run from the main loop.
+	 */
+	i2c_pending = 1;
+	usbDisableAllRequests();
+	return 1;
+}
+
+void rq_bus_poll(void)
+{
+	if (!i2c_pending)
+	{
+		return;
+	}
+	i2c_res_len = i2c_bridge_run(i2c_batch, i2c_batch_len, i2c_res);
+	i2c_pending = 0;
+	printlnd("I2C batch done");
+}
+
+uint8_t rq_bus_busy(void)
+{
+	return i2c_pending;
+}
+
+usbMsgLen_t rq_i2c_xfer(usbRequest_t *rq)
+{
+	printlnd("I2C Xfer");
+	rq_write = i2c_batch_write;
+	i2c_batch_len = 0;
+	i2c_batch_size = I2C_BATCH_SIZE;
+	if (rq->wLength.word < i2c_batch_size)
+	{
+		i2c_batch_size = rq->wLength.word;
+	}
+	if (i2c_batch_size == 0)
+	{
+		return 0;
+	}
+	return USB_NO_MSG; /* use usbFunctionWrite() to receive the data */
+}
+
+usbMsgLen_t rq_i2c_result(usbRequest_t *rq UNUSED)
+{
+	printlnd("I2C Result");
+	usbMsgPtr = i2c_res;
+	return i2c_res_len; /* the results */
+}
+
+usbMsgLen_t rq_spi_init(usbRequest_t *rq)
+{
+	printlnd("SPI Init");
+	if (spi_bridge_init(rq->wValue.bytes[0], rq->wValue.bytes[1],
+						rq->wIndex.bytes[0], rq->wIndex.bytes[1]) == -1)
+	{
+		spi_bridge_shut();
+		rq_buf[0] = SPI_ST_INVALID;
+	}
+	else
+	{
+		rq_buf[0] = SPI_ST_OK;
+	}
+	usbMsgPtr = rq_buf;
+	return 1;
+}
+
+static uchar spi_write(uchar *data, uchar len)
+{
+	if (len > spi_size)
+	{
+		len = spi_size;
+	}
+	if (spi_buf[0] == SPI_ST_OK)
+	{
+		memcpy(spi_buf + 1 + spi_len, data, len);
+		if (spi_bridge_xfer(spi_buf + 1 + spi_len, len) == -1)
+		{
+			spi_buf[0] = SPI_ST_NO_MASTER; // Rest of the bytes are dropped
+		}
+		else
+		{
+			spi_len += len;
+		}
+	}
+	spi_size -= len;
+	if (spi_size)
+	{
+		return 0; /* expecting more data */
+	}
+	spi_bridge_select(spi_keep_selected);
+	printlnd("SPI xfer done");
+	return 1;
+}
+
+usbMsgLen_t rq_spi_xfer(usbRequest_t *rq)
+{
+	printlnd("SPI Xfer");
+	rq_write = spi_write;
+	spi_buf[0] = SPI_ST_OK;
+	spi_len = 0;
+	spi_size = SPI_BUF_SIZE;
+	if (rq->wLength.word < spi_size)
+	{
+		spi_size = rq->wLength.word;
+	}
+	spi_keep_selected = rq->wValue.bytes[0] & 1;
+	spi_bridge_select(1);
+	if (spi_size == 0)
+	{
+		spi_bridge_select(spi_keep_selected);
+		return 0;
+	}
+	return USB_NO_MSG; /* use usbFunctionWrite() to receive the data */
+}
+
+usbMsgLen_t rq_spi_read(usbRequest_t *rq UNUSED)
+{
+	printlnd("SPI Read");
+	usbMsgPtr = spi_buf;
+	return 1 + spi_len; /* the status & the bytes received */
+}
@@ -0,0 +1,222 @@
+/*
+ * Copyright (C) eSrijan Innovations Private Limited
+ *
+ * Author: Anil Kumar Pugalia <anil_pugalia@eSrijan.com>
+ *
+ * Licensed under: JSL (See LICENSE file for details)
+ *
+ * ATmega16/32
+ *
+ * GPIO Request Handlers: Register batches, micro-sequencer, change events
+ */
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <string.h>
+
+#include "requests.h"
+#include "rq.h"
+#include "serial.h"
+#include "eeprom_q.h"
+#include "regs.h"
+#include "seq.h"
+#include "evt.h"
+
+#if (REG_BATCH_MAX * 4 > RQ_SCRATCH_SIZE)
+#error "rq_scratch too small for the register batch"
+#endif
+
+#define reg_batch ((uint8_t (*)[4])(rq_scratch)) /* register, op, mask, value */
+static uint8_t reg_batch_len; /* Bytes received of the batch */
+static uint8_t reg_batch_size; /* Bytes expected in the batch */
+static uint8_t reg_batch_res[REG_BATCH_MAX]; /* Read results of the last batch */
+static uint8_t reg_batch_res_cnt;
+
+static uint8_t seq_state = SEQ_ST_IDLE;
+static uint8_t seq_masked; /* Run the sequence with interrupts masked */
+static uint8_t seq_len; /* Bytes received of the sequence being loaded */
+static uint8_t seq_size; /* Bytes expected of the sequence being loaded */
+
+static void exec_reg_batch(void)
+{
+	volatile uint8_t *wr_reg, *rd_reg;
+	uint8_t wr_mask, rd_mask;
+	uint8_t i, mask, val, dird_used = 0;
+	uint8_t sreg = SREG;
+
+	reg_batch_res_cnt = 0;
+	for (i = 0; i < reg_batch_size / 4; i++)
+	{
+		if (!get_reg(reg_batch[i][0], &wr_reg, &wr_mask, &rd_reg, &rd_mask))
+		{
+			if (reg_batch[i][1] == REG_OP_READ)
+			{
+				reg_batch_res[reg_batch_res_cnt++] = 0xFF;
+			}
+			continue;
+		}
+		mask = reg_batch[i][2] & ~wr_mask;
+		cli(); // Each operation in one go, without any interleaving
+		val = *wr_reg;
+		switch (reg_batch[i][1])
+		{
+			case REG_OP_SET:
+				*wr_reg = val | mask;
+				break;
+			case REG_OP_CLEAR:
+				*wr_reg = val & ~mask;
+				break;
+			case REG_OP_TOGGLE:
+				*wr_reg = val ^ mask;
+				break;
+			case REG_OP_WRITE:
+				*wr_reg = (val & ~mask) | (reg_batch[i][3] & mask);
+				break;
+			case REG_OP_READ:
+				reg_batch_res[reg_batch_res_cnt++] = *rd_reg & reg_batch[i][2] & ~rd_mask;
+				break;
+			default:
+				break;
+		}
+		SREG = sreg;
+		if (wr_reg == &DDRD)
+		{
+			dird_used = 1;
+		}
+	}
+	if (dird_used)
+	{
+		if ((DDRD & ~MASK_PORTD) & 0b11) // PD0 & PD1 - are being used
+			usart_disable(); // Serial needs to be disabled
+		else
+			usart_enable(); // Serial can be re-enabled
+	}
+}
+
+static uchar reg_batch_write(uchar *data, uchar len)
+{
+	for (; len && (reg_batch_len < reg_batch_size); len--)
+	{
+		rq_scratch[reg_batch_len++] = *data++;
+	}
+	if (reg_batch_len < reg_batch_size)
+	{
+		return 0; /* expecting more data */
+	}
+	exec_reg_batch();
+	printlnd("Reg batch done");
+	return 1;
+}
+
+usbMsgLen_t rq_reg_batch(usbRequest_t *rq)
+{
+	printlnd("Reg Batch");
+	rq_write = reg_batch_write;
+	reg_batch_len = 0;
+	reg_batch_size = REG_BATCH_MAX * 4;
+	if (rq->wLength.word < reg_batch_size)
+	{
+		reg_batch_size = rq->wLength.word & ~0b11;
+	}
+	if (reg_batch_size == 0)
+	{
+		return 0;
+	}
+	return USB_NO_MSG; /* use usbFunctionWrite() to receive the data */
+}
+
+usbMsgLen_t rq_get_reg_batch(usbRequest_t *rq UNUSED)
+{
+	printlnd("Reg Batch Get");
+	usbMsgPtr = reg_batch_res;
+	return reg_batch_res_cnt; /* the read results */
+}
+
+static void load_seq(unsigned off)
+{
+	uint8_t i;
+
+	for (i = 0; i < SEQ_SIZE; i++, off++)
+	{
+		seq_prog[i] = (off < EEPROM_SIZE - EEPROM_START) ?
+			eeprom_q_read_byte((uint8_t *)(EEPROM_START + off)) : SEQ_OP_END;
+	}
+}
+
+static uchar seq_write(uchar *data, uchar len)
+{
+	for (; len && (seq_len < seq_size); len--)
+	{
+		seq_prog[seq_len++] = *data++;
+	}
+	if (seq_len < seq_size)
+	{
+		return 0; /* expecting more data */
+	}
+	printlnd("Seq loaded");
+	return 1;
+}
+
+usbMsgLen_t rq_set_seq(usbRequest_t *rq)
+{
+	printlnd("Seq Set");
+	rq_write = seq_write;
+	memset(seq_prog, SEQ_OP_END, sizeof(seq_prog));
+	seq_len = 0;
+	seq_size = sizeof(seq_prog);
+	if (rq->wLength.word < seq_size)
+	{
+		seq_size = rq->wLength.word;
+	}
+	if (seq_size == 0)
+	{
+		return 0;
+	}
+	return USB_NO_MSG; /* use usbFunctionWrite() to receive the data */
+}
+
+usbMsgLen_t rq_run_seq(usbRequest_t *rq)
+{
+	printlnd("Seq Run");
+	if (rq->wValue.bytes[0] & 2)
+	{
+		load_seq(rq->wIndex.word);
+	}
+	seq_masked = rq->wValue.bytes[0] & 1;
+	seq_state = SEQ_ST_RUNNING; // Run from the main loop, after this request completes
+	return 0;
+}
+
+usbMsgLen_t rq_get_seq_status(usbRequest_t *rq UNUSED)
+{
+	printlnd("Seq Status");
+	rq_buf[0] = seq_state;
+	rq_buf[1] = seq_res_cnt;
+	usbMsgPtr = rq_buf;
+	return 2;
+}
+
+usbMsgLen_t rq_set_events(usbRequest_t *rq)
+{
+	printlnd("Set Events");
+	evt_watch(rq->wIndex.bytes[0], rq->wValue.bytes[0]);
+	if (evt_watching() && !ep1_sending(evt_read))
+	{
+		start_ep1_data(evt_read);
+	}
+	return 0;
+}
+
+void rq_gpio_poll(void)
+{
+	if (seq_state != SEQ_ST_RUNNING)
+	{
+		return;
+	}
+	if (seq_masked && !usb_ctrl_idle()) // Let the status stage of the run request go first
+	{
+		return;
+	}
+	seq_state = seq_run(seq_masked);
+	start_ep1_buf(seq_res, seq_res_cnt);
+}
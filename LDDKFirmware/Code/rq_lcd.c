@@ -0,0 +1,42 @@
+/*
+ * Copyright (C) eSrijan Innovations Private Limited
+ *
+ * Author: Anil Kumar Pugalia <anil_pugalia@eSrijan.com>
+ *
+ * Licensed under: JSL (See LICENSE file for details)
+ *
+ * ATmega16/32
+ *
+ * Character LCD Request Handlers
+ */
+
+#include <avr/io.h>
+
+#include "requests.h"
+#include "rq.h"
+#include "clcd_fb.h"
+
+static unsigned lcd_wr_len; /* Bytes remaining of the text being written */
+
+static uchar lcd_write(uchar *data, uchar len)
+{
+	if (len > lcd_wr_len)
+	{
+		len = lcd_wr_len;
+	}
+	clcd_fb_write(data, len);
+	lcd_wr_len -= len;
+	return (lcd_wr_len == 0);
+}
+
+usbMsgLen_t rq_lcd_write(usbRequest_t *rq)
+{
+	/* No printlnd, as that would write over the text */
+	rq_write = lcd_write;
+	lcd_wr_len = rq->wLength.word;
+	if (lcd_wr_len == 0)
+	{
+		return 0;
+	}
+	return USB_NO_MSG; /* use usbFunctionWrite() to receive the data */
+}
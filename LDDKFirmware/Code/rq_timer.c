@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) eSrijan Innovations Private Limited
+ *
+ * Author: Anil Kumar Pugalia <anil_pugalia@eSrijan.com>
+ *
+ * Licensed under: JSL (See LICENSE file for details)
+ *
+ * ATmega16/32
+ *
+ * Timer Request Handlers: PWM & input capture
+ */
+
+#include <avr/io.h>
+
+#include "requests.h"
+#include "rq.h"
+#include "pwm.h"
+#include "icp.h"
+
+#if (ICP_RESULT_SIZE > RQ_BUF_SIZE)
+#error "rq_buf too small for the ICP result"
+#endif
+
+usbMsgLen_t rq_set_pwm(usbRequest_t *rq)
+{
+	uint8_t timer = rq->wIndex.bytes[0] & 0x0F;
+	uint32_t freq = rq->wValue.word;
+	int32_t actual;
+
+	printlnd("Set PWM");
+	if (rq->wIndex.bytes[0] & (1 << 7))
+	{
+		freq *= 1000;
+	}
+#ifdef USE_ACQ
+	if (timer == 0)
+	{
+		rq_acq_stop(); // Shares Timer0
+	}
+#endif
+	actual = pwm_set(timer, (rq->wIndex.bytes[0] >> 4) & 0b11, freq, rq->wIndex.bytes[1]);
+	if (actual == -1)
+	{
+		return 0;
+	}
+	rq_buf[0] = actual & 0xFF;
+	rq_buf[1] = (actual >> 8) & 0xFF;
+	rq_buf[2] = (actual >> 16) & 0xFF;
+	rq_buf[3] = (actual >> 24) & 0xFF;
+	usbMsgPtr = rq_buf;
+	return 4;
+}
+
+usbMsgLen_t rq_start_icp(usbRequest_t *rq)
+{
+	printlnd("ICP Start");
+	icp_start(rq->wValue.bytes[0], rq->wValue.bytes[1] & 1);
+	return 0;
+}
+
+usbMsgLen_t rq_get_icp(usbRequest_t *rq UNUSED)
+{
+	printlnd("ICP Get");
+	icp_read(rq_buf);
+	usbMsgPtr = rq_buf;
+	return ICP_RESULT_SIZE; /* the measurement */
+}
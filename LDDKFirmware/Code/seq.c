@@ -0,0 +1,275 @@
+/*
+ * Copyright (C) eSrijan Innovations Private Limited
+ * 
+ * Author: Anil Kumar Pugalia <anil_pugalia@eSrijan.com>
+ *
+ * Licensed under: JSL (See LICENSE file for details)
+ *
+ * ATmega16/32
+ *
+ * GPIO Micro-Sequencer Functions
+ */
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+
+#include "requests.h"
+#include "regs.h"
+#include "timer.h"
+#include "seq.h"
+
+#define TICKS_PER_CHUNK (4000 * TIMER_TICKS_PER_US) /* fits in 16 bits */
+#define OP_US 4 /* Upper bound for an instruction, other than its wait */
+#define TOO_LONG (SEQ_MAX_US + 1)
+#define INVALID (SEQ_MAX_US + 2)
+
+uint8_t seq_prog[SEQ_SIZE];
+uint8_t seq_res[SEQ_RES_SIZE];
+uint8_t seq_res_cnt;
+
+/* Operand bytes following each instruction */
+static const PROGMEM uint8_t op_len[] =
+{
+	[SEQ_OP_END] = 0,
+	[SEQ_OP_WRITE] = 3,
+	[SEQ_OP_READ] = 2,
+	[SEQ_OP_EMIT] = 0,
+	[SEQ_OP_WAIT_US] = 2,
+	[SEQ_OP_WAIT_PIN] = 5,
+	[SEQ_OP_LOOP] = 1,
+	[SEQ_OP_NEXT] = 0
+};
+
+/*
+ * Checks the time elapsed from start, against us, taking in upto 4ms at a time.
+ * Only TCNT1 is used, so that it works with interrupts masked as well.
+ */
+static uint8_t elapsed(uint16_t *start, uint16_t *us)
+{
+	uint16_t ticks;
+
+	ticks = (*us > 4000) ? TICKS_PER_CHUNK : (*us * TIMER_TICKS_PER_US);
+	if ((uint16_t)(timer_cnt() - *start) < ticks)
+	{
+		return 0;
+	}
+	if (*us <= 4000)
+	{
+		return 1;
+	}
+	*start += TICKS_PER_CHUNK;
+	*us -= 4000;
+	return 0;
+}
+
+/*
+ * Works out the worst case run time of the sequence in seq_prog, in us, taking
+ * each wait in full & each loop for its count, with a loop left open run once.
+ * Returns TOO_LONG, once beyond SEQ_MAX_US, & INVALID for an invalid sequence.
+ */
+static uint32_t worst_us(void)
+{
+	uint8_t *pc = seq_prog;
+	uint32_t us[SEQ_LOOP_DEPTH + 1]; /* Of the sequence, followed by the open loop bodies */
+	uint16_t cnt[SEQ_LOOP_DEPTH + 1];
+	uint8_t depth = 0, op, len;
+
+	us[0] = 0;
+	while ((pc < seq_prog + SEQ_SIZE) && (*pc != SEQ_OP_END))
+	{
+		op = *pc++;
+		if (op >= sizeof(op_len))
+		{
+			return INVALID;
+		}
+		len = pgm_read_byte(&op_len[op]);
+		if (len > seq_prog + SEQ_SIZE - pc) // Operands cut off
+		{
+			return INVALID;
+		}
+		us[depth] += OP_US;
+		switch (op)
+		{
+			case SEQ_OP_WAIT_US:
+				us[depth] += pc[0] | (pc[1] << 8);
+				break;
+			case SEQ_OP_WAIT_PIN:
+				us[depth] += pc[3] | (pc[4] << 8);
+				break;
+			case SEQ_OP_LOOP:
+				if (depth == SEQ_LOOP_DEPTH)
+				{
+					return INVALID;
+				}
+				depth++;
+				us[depth] = 0;
+				cnt[depth] = pc[0] ? pc[0] : 256;
+				break;
+			case SEQ_OP_NEXT:
+				if (depth == 0)
+				{
+					return INVALID;
+				}
+				if (us[depth] > SEQ_MAX_US / cnt[depth])
+				{
+					return TOO_LONG;
+				}
+				us[depth - 1] += us[depth] * cnt[depth];
+				depth--;
+				break;
+		}
+		if (us[depth] > SEQ_MAX_US)
+		{
+			return TOO_LONG;
+		}
+		pc += len;
+	}
+	for (; depth; depth--)
+	{
+		us[depth - 1] += us[depth];
+	}
+	return (us[0] > SEQ_MAX_US) ? TOO_LONG : us[0];
+}
+
+uint8_t seq_run(uint8_t masked)
+{
+	uint8_t sreg = SREG;
+	uint8_t *pc = seq_prog;
+	uint8_t *loop_pc[SEQ_LOOP_DEPTH];
+	uint8_t loop_cnt[SEQ_LOOP_DEPTH];
+	uint8_t loop_depth = 0;
+	uint8_t op, acc = 0, status = SEQ_ST_DONE;
+	volatile uint8_t *wr_reg, *rd_reg;
+	uint8_t wr_mask, rd_mask;
+	uint16_t start, us;
+	uint32_t run_start = timer_now();
+
+	seq_res_cnt = 0;
+	switch (worst_us())
+	{
+		case INVALID:
+			return SEQ_ST_ERROR;
+		case TOO_LONG:
+			return SEQ_ST_TOO_LONG;
+	}
+	if (masked)
+	{
+		cli();
+	}
+	while (pc < seq_prog + SEQ_SIZE)
+	{
+		op = *pc++;
+		switch (op)
+		{
+			case SEQ_OP_END:
+				goto done;
+			case SEQ_OP_WRITE: /* reg, mask, value */
+				if (!get_reg(pc[0], &wr_reg, &wr_mask, &rd_reg, &rd_mask))
+				{
+					status = SEQ_ST_ERROR;
+					goto done;
+				}
+				*wr_reg = (*wr_reg & ~(pc[1] & ~wr_mask)) | (pc[2] & pc[1] & ~wr_mask);
+				pc += 3;
+				break;
+			case SEQ_OP_READ: /* reg, mask */
+				if (!get_reg(pc[0], &wr_reg, &wr_mask, &rd_reg, &rd_mask))
+				{
+					status = SEQ_ST_ERROR;
+					goto done;
+				}
+				acc = *rd_reg & pc[1] & ~rd_mask;
+				pc += 2;
+				break;
+			case SEQ_OP_EMIT:
+				if (seq_res_cnt < SEQ_RES_SIZE)
+				{
+					seq_res[seq_res_cnt++] = acc;
+				}
+				break;
+			case SEQ_OP_WAIT_US: /* us (2 bytes, LSB first) */
+				start = timer_cnt();
+				us = pc[0] | (pc[1] << 8);
+				pc += 2;
+				if (masked)
+				{
+					SREG = sreg;
+				}
+				while (!elapsed(&start, &us))
+					;
+				if (masked)
+				{
+					cli();
+				}
+				break;
+			case SEQ_OP_WAIT_PIN: /* reg, mask, value, timeout us (2 bytes, LSB first) */
+				if (!get_reg(pc[0], &wr_reg, &wr_mask, &rd_reg, &rd_mask))
+				{
+					status = SEQ_ST_ERROR;
+					goto done;
+				}
+				start = timer_cnt();
+				us = pc[3] | (pc[4] << 8);
+				if (masked)
+				{
+					SREG = sreg;
+				}
+				while ((*rd_reg & pc[1] & ~rd_mask) != (pc[2] & pc[1] & ~rd_mask))
+				{
+					if (elapsed(&start, &us))
+					{
+						status = SEQ_ST_TIMEOUT;
+						goto done;
+					}
+				}
+				if (masked)
+				{
+					cli();
+				}
+				pc += 5;
+				break;
+			case SEQ_OP_LOOP: /* count (0 for 256) */
+				if (loop_depth == SEQ_LOOP_DEPTH)
+				{
+					status = SEQ_ST_ERROR;
+					goto done;
+				}
+				loop_cnt[loop_depth] = *pc++;
+				loop_pc[loop_depth++] = pc;
+				break;
+			case SEQ_OP_NEXT:
+				if (loop_depth == 0)
+				{
+					status = SEQ_ST_ERROR;
+					goto done;
+				}
+				if (masked) // Let the interrupts in, between the passes
+				{
+					SREG = sreg;
+					asm volatile ("nop");
+					cli();
+				}
+				if (timer_now() - run_start > (uint32_t)(SEQ_MAX_US) * TIMER_TICKS_PER_US)
+				{
+					status = SEQ_ST_TOO_LONG; // Beyond the worst case worked out
+					goto done;
+				}
+				if (--loop_cnt[loop_depth - 1])
+				{
+					pc = loop_pc[loop_depth - 1];
+				}
+				else
+				{
+					loop_depth--;
+				}
+				break;
+			default:
+				status = SEQ_ST_ERROR;
+				goto done;
+		}
+	}
+done:
+	SREG = sreg;
+	return status;
+}
@@ -0,0 +1,36 @@
+/*
+ * Copyright (C) eSrijan Innovations Private Limited
+ * 
+ * Author: Anil Kumar Pugalia <anil_pugalia@eSrijan.com>
+ *
+ * Licensed under: JSL (See LICENSE file for details)
+ *
+ * ATmega16/32
+ *
+ * Header for GPIO Micro-Sequencer Functions
+ *
+ * A sequence is a byte code program of SEQ_OP_* instructions (see requests.h),
+ * run from seq_prog. The bytes emitted by it are collected in seq_res.
+ * Timings are taken from the free running Timer1 (see timer.h).
+ */
+
+#ifndef SEQ_H
+#define SEQ_H
+
+#include <avr/io.h>
+
+#define SEQ_SIZE 64 /* in bytes */
+#define SEQ_RES_SIZE 32 /* in bytes */
+#define SEQ_LOOP_DEPTH 4
+
+extern uint8_t seq_prog[SEQ_SIZE];
+extern uint8_t seq_res[SEQ_RES_SIZE];
+extern uint8_t seq_res_cnt;
+
+/*
+ * Runs the sequence in seq_prog, if its worst case run time is within SEQ_MAX_US,
+ * with interrupts masked, if so, except during the waits & between loop passes.
+ * Returns SEQ_ST_*
+ */
+uint8_t seq_run(uint8_t masked);
+#endif
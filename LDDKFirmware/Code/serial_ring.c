@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) eSrijan Innovations Private Limited
+ * 
+ * Author: Anil Kumar Pugalia <anil_pugalia@eSrijan.com>
+ *
+ * Licensed under: JSL (See LICENSE file for details)
+ *
+ * ATmega16/32
+ *
+ * Ring Buffered Serial Communication Functions
+ */
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include "intr.h"
+#include "serial_ring.h"
+
+static uint8_t rx_ring[SERIAL_RX_RING_SIZE];
+static uint8_t tx_ring[SERIAL_TX_RING_SIZE];
+/* Free running indices - head updated by the producer, & tail by the consumer */
+static volatile uint8_t rx_head, rx_tail;
+static volatile uint8_t tx_head, tx_tail;
+static volatile uint16_t rx_overruns;
+
+ISR_UNBLOCKED(USART_RXC_vect, UCSRB, RXCIE)
+{
+	uint8_t data;
+
+	if (UCSRA & (1 << DOR)) /* Byte(s) lost before this one */
+	{
+		rx_overruns++;
+	}
+	data = UDR;
+	if ((uint8_t)(rx_head - rx_tail) < SERIAL_RX_RING_SIZE)
+	{
+		rx_ring[rx_head & (SERIAL_RX_RING_SIZE - 1)] = data;
+		rx_head++;
+	}
+	else
+	{
+		rx_overruns++;
+	}
+	cli(); /* Avoid nesting, till the return */
+	UCSRB |= (1 << RXCIE);
+}
+ISR_UNBLOCKED(USART_UDRE_vect, UCSRB, UDRIE)
+{
+	if (tx_head == tx_tail) /* UDRIE restored by a stale read-modify-write of UCSRB */
+		return;
+	/* Goes nowhere, if the transmitter has been disabled meanwhile */
+	UDR = tx_ring[tx_tail & (SERIAL_TX_RING_SIZE - 1)];
+	tx_tail++;
+	if (tx_head != tx_tail)
+	{
+		cli(); /* Avoid nesting, till the return */
+		UCSRB |= (1 << UDRIE);
+	}
+}
+
+void serial_ring_init(unsigned long baud)
+{
+	usart_init(baud);
+	UCSRB |= (1 << RXCIE); /* Enable receive complete interrupt */
+}
+void serial_ring_tx(const uint8_t *data, uint8_t len)
+{
+	for (; len; len--)
+	{
+		if (!(UCSRB & (1 << TXEN))) /* Transmitter disabled */
+			return;
+		/* Wait for space in the transmit ring */
+		while ((uint8_t)(tx_head - tx_tail) >= SERIAL_TX_RING_SIZE)
+			;
+		tx_ring[tx_head & (SERIAL_TX_RING_SIZE - 1)] = *data++;
+		tx_head++;
+		UCSRB |= (1 << UDRIE); /* Enable data register empty interrupt to send it */
+	}
+}
+void serial_ring_tx_str(char *str)
+{
+	while (*str)
+	{
+		serial_ring_tx((uint8_t *)(str++), 1);
+	}
+}
+uint8_t serial_ring_rx(uint8_t *data, uint8_t max_len)
+{
+	uint8_t i;
+
+	for (i = 0; (i < max_len) && (rx_head != rx_tail); i++)
+	{
+		data[i] = rx_ring[rx_tail & (SERIAL_RX_RING_SIZE - 1)];
+		rx_tail++;
+	}
+	return i;
+}
+uint8_t serial_ring_rx_count(void)
+{
+	return rx_head - rx_tail;
+}
+uint8_t serial_ring_tx_free(void)
+{
+	return SERIAL_TX_RING_SIZE - (uint8_t)(tx_head - tx_tail);
+}
+uint16_t serial_ring_rx_overruns(int reset)
+{
+	uint16_t cnt;
+	uint8_t sreg = SREG;
+
+	cli();
+	cnt = rx_overruns;
+	if (reset)
+	{
+		rx_overruns = 0;
+	}
+	SREG = sreg;
+	return cnt;
+}
@@ -0,0 +1,36 @@
+/*
+ * Copyright (C) eSrijan Innovations Private Limited
+ * 
+ * Author: Anil Kumar Pugalia <anil_pugalia@eSrijan.com>
+ *
+ * Licensed under: JSL (See LICENSE file for details)
+ *
+ * ATmega16/32
+ *
+ * Header for Ring Buffered Serial Communication Functions
+ *
+ * Both the receive & transmit sides are buffered in rings, filled & drained by
+ * the USART interrupts, on top of the (polled) serial communication functions.
+ * So, transmitting blocks only if the transmit ring is full, and bytes received
+ * are not lost as long as the receive ring is not full.
+ */
+
+#ifndef SERIAL_RING_H
+#define SERIAL_RING_H
+
+#include <avr/io.h>
+
+#include "serial.h"
+
+#define SERIAL_RX_RING_SIZE 64 /* should be a power of 2 */
+#define SERIAL_TX_RING_SIZE 64 /* should be a power of 2 */
+
+void serial_ring_init(unsigned long baud);
+void serial_ring_tx(const uint8_t *data, uint8_t len);
+void serial_ring_tx_str(char *str);
+uint8_t serial_ring_rx(uint8_t *data, uint8_t max_len);
+uint8_t serial_ring_rx_count(void);
+uint8_t serial_ring_tx_free(void);
+/* Bytes lost, for the receive ring being full, or the USART not being read in time */
+uint16_t serial_ring_rx_overruns(int reset);
+#endif
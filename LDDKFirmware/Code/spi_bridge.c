@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) eSrijan Innovations Private Limited
+ * 
+ * Author: Anil Kumar Pugalia <anil_pugalia@eSrijan.com>
+ *
+ * Licensed under: JSL (See LICENSE file for details)
+ *
+ * ATmega16/32
+ *
+ * USB to SPI Bridge Functions
+ */
+
+#include <avr/io.h>
+
+#include "requests.h"
+#include "regs.h"
+#include "spi_bridge.h"
+
+static volatile uint8_t *cs_port;
+static uint8_t cs_bit_mask;
+
+int spi_bridge_init(uint8_t div, uint8_t mode, uint8_t cs_reg, uint8_t cs_bit)
+{
+	volatile uint8_t *cs_dir, *rd_reg;
+	uint8_t wr_mask, rd_mask;
+
+	if ((div > 6) || (mode > 0b111) || (cs_bit > 7))
+		return -1;
+	if ((cs_reg < REG_PORTA) ||
+		!get_reg(cs_reg - (REG_PORTA - REG_DIRA), &cs_dir, &wr_mask, &rd_reg, &rd_mask) ||
+		(wr_mask & (1 << cs_bit)))
+		return -1;
+
+	spi_bridge_shut();
+	get_reg(cs_reg, &cs_port, &wr_mask, &rd_reg, &rd_mask);
+	cs_bit_mask = (1 << cs_bit);
+	*cs_port |= cs_bit_mask; /* Deselected */
+	*cs_dir |= cs_bit_mask;
+
+	DDRB |= (1 << PB5) | (1 << PB7); /* MOSI & SCK as output */
+	DDRB &= ~(1 << PB6); /* MISO as input */
+	/* /2, /8, /32 are with SPI2X, & /4, /16, /64, /128 without */
+	if ((div & 1) || (div == 6))
+		SPSR &= ~(1 << SPI2X);
+	else
+		SPSR |= (1 << SPI2X);
+	SPCR = (1 << SPE) | (1 << MSTR) | ((mode & 0b100) ? (1 << DORD) : 0) |
+			((mode & 0b11) << CPHA) | ((div >> 1) << SPR0);
+	return 0;
+}
+void spi_bridge_shut(void)
+{
+	if (cs_port)
+	{
+		*cs_port |= cs_bit_mask; /* Deselected */
+	}
+	SPCR = 0;
+	DDRB &= ~(1 << PB5); /* SCK stays an output, for the PGM LED */
+}
+void spi_bridge_select(uint8_t select)
+{
+	if (!cs_port)
+		return;
+	if (select)
+		*cs_port &= ~cs_bit_mask;
+	else
+		*cs_port |= cs_bit_mask;
+}
+int spi_bridge_xfer(uint8_t *data, uint8_t len)
+{
+	uint8_t i;
+
+	for (i = 0; i < len; i++)
+	{
+		if (!(SPCR & (1 << MSTR))) /* Not initialized, or dropped out of master */
+			return -1;
+		SPDR = data[i];
+		while (!(SPSR & (1 << SPIF))) /* Also set on dropping out of master */
+			;
+		data[i] = SPDR;
+	}
+	return (SPCR & (1 << MSTR)) ? 0 : -1;
+}
@@ -0,0 +1,35 @@
+/*
+ * Copyright (C) eSrijan Innovations Private Limited
+ * 
+ * Author: Anil Kumar Pugalia <anil_pugalia@eSrijan.com>
+ *
+ * Licensed under: JSL (See LICENSE file for details)
+ *
+ * ATmega16/32
+ *
+ * Header for USB to SPI Bridge Functions
+ *
+ * SPI master on the hardware SPI: PB5 (MOSI), PB6 (MISO), PB7 (SCK). PB7 is
+ * also the PGM LED, which would flicker with the clock. PB4 (SS) is left as
+ * an input, pulled-up for the DOWNLOAD switch. So, pressing the switch would
+ * drop the SPI out of the master mode, till it is initialized again. Chip
+ * select is any unprotected port pin, driven low while selected.
+ * Clock divisor select is from 0 to 6 for F_CPU / 2, 4, 8, ..., 128.
+ */
+
+#ifndef SPI_BRIDGE_H
+#define SPI_BRIDGE_H
+
+#include <avr/io.h>
+
+#define SPI_BUF_SIZE 64 /* in bytes */
+
+/* mode: bits 1-0: SPI mode (CPOL, CPHA); bit 2: LSB first */
+/* Returns 0 on success, -1 for invalid parameters */
+int spi_bridge_init(uint8_t div, uint8_t mode, uint8_t cs_reg, uint8_t cs_bit);
+void spi_bridge_shut(void);
+void spi_bridge_select(uint8_t select);
+/* Exchanges the bytes in place, as they are sent, with the bytes received */
+/* Returns 0 on success, -1 if not (or no more) the master */
+int spi_bridge_xfer(uint8_t *data, uint8_t len);
+#endif
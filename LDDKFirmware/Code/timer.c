@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) eSrijan Innovations Private Limited
+ * 
+ * Author: Anil Kumar Pugalia <anil_pugalia@eSrijan.com>
+ *
+ * Licensed under: JSL (See LICENSE file for details)
+ *
+ * ATmega16/32
+ *
+ * Time Base Functions
+ */
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include "timer.h"
+
+volatile uint16_t timer_ovf_cnt;
+
+ISR(TIMER1_OVF_vect, ISR_NOBLOCK)
+{
+	timer_ovf_cnt++;
+}
+
+void timer_init(void)
+{
+	TCCR1A = 0; /* Normal mode */
+	TCCR1B = (0b001 << CS10); /* No prescaling => Clock @ F_CPU */
+	TIMSK |= (1 << TOIE1); /* Enable overflow interrupt */
+}
+uint16_t timer_cnt(void)
+{
+	uint8_t sreg = SREG;
+	uint16_t cnt;
+
+	cli();
+	cnt = TCNT1;
+	SREG = sreg;
+	return cnt;
+}
+uint32_t timer_now(void)
+{
+	uint8_t sreg = SREG;
+	uint16_t cnt, ovf_cnt;
+
+	cli();
+	cnt = TCNT1;
+	ovf_cnt = timer_ovf_cnt;
+	if ((TIFR & (1 << TOV1)) && (cnt < 0x8000)) /* Overflowed, but not yet counted */
+	{
+		ovf_cnt++;
+	}
+	SREG = sreg;
+	return ((uint32_t)(ovf_cnt) << 16) | cnt;
+}
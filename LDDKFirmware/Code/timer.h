@@ -0,0 +1,30 @@
+/*
+ * Copyright (C) eSrijan Innovations Private Limited
+ * 
+ * Author: Anil Kumar Pugalia <anil_pugalia@eSrijan.com>
+ *
+ * Licensed under: JSL (See LICENSE file for details)
+ *
+ * ATmega16/32
+ *
+ * Header for Time Base Functions
+ *
+ * Timer1 runs free at F_CPU, i.e. one tick per CPU cycle. Its overflows, every
+ * 65536 ticks (4.096ms at 16MHz), are counted in timer_ovf_cnt, extending it
+ * to a 32-bit time stamp. Its 16-bit registers share the TEMP register for the
+ * high byte, & so are accessed with the interrupts masked, outside the handlers.
+ */
+
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <avr/io.h>
+
+#define TIMER_TICKS_PER_US (F_CPU / 1000000)
+
+extern volatile uint16_t timer_ovf_cnt;
+
+void timer_init(void);
+uint16_t timer_cnt(void);
+uint32_t timer_now(void);
+#endif
@@ -0,0 +1 @@
+../../Examples/twi.h
\ No newline at end of file
@@ -120,6 +120,12 @@ section at the end of this file).
 /* Define this to 1 if the device has its own power supply. Set it to 0 if the
  * device is powered from the USB bus.
  */
+#define USB_CFG_REMOTE_WAKEUP           1
+/* Define this to 1 if the device can wake up the host from the suspend, on the
+ * BUTTON press. It is then advertised in the configuration descriptor, which
+ * is thus supplied by main.c, & signalled only once the host enables it, as
+ * tracked in power.c through the USB_RX_USER_HOOK & USB_RESET_HOOK.
+ */
 #ifdef USE_CLCD
 #define USB_CFG_MAX_BUS_POWER           500
 #else
@@ -129,12 +135,12 @@ section at the end of this file).
  * The value is in milliamperes. [It will be divided by two since USB
  * communicates power requirements in units of 2 mA.]
  */
-#define USB_CFG_IMPLEMENT_FN_WRITE      0
+#define USB_CFG_IMPLEMENT_FN_WRITE      1
 /* Set this to 1 if you want usbFunctionWrite() to be called for control-out
  * transfers. Set it to 0 if you don't need it and want to save a couple of
  * bytes.
  */
-#define USB_CFG_IMPLEMENT_FN_READ       0
+#define USB_CFG_IMPLEMENT_FN_READ       1
 /* Set this to 1 if you need to send control replies which are generated
  * "on the fly" when usbFunctionRead() is called. If you only want to send
  * data from a static buffer, set it to 0 and return the data from
@@ -146,7 +152,7 @@ section at the end of this file).
  * interrupt/bulk data sent to any endpoint other than 0. The endpoint number
  * can be found in 'usbRxToken'.
  */
-#define USB_CFG_HAVE_FLOWCONTROL        0
+#define USB_CFG_HAVE_FLOWCONTROL        1
 /* Define this to 1 if you want flowcontrol over USB data. See the definition
  * of the macros usbDisableAllRequests() and usbEnableAllRequests() in
  * usbdrv.h.
@@ -156,14 +162,27 @@ section at the end of this file).
  * in a single control-in or control-out transfer. Note that the capability
  * for long transfers increases the driver size.
  */
+#if USB_CFG_REMOTE_WAKEUP
+#ifndef __ASSEMBLER__
+extern void power_usb_setup(unsigned char *data, unsigned char len);
+extern void power_usb_reset(void);
+#endif
+#define USB_RX_USER_HOOK(data, len)     if(usbRxToken == (uchar)USBPID_SETUP) power_usb_setup(data, len);
+#else
 /* #define USB_RX_USER_HOOK(data, len)     if(usbRxToken == (uchar)USBPID_SETUP) blinkLED(); */
+#endif
 /* This macro is a hook if you want to do unconventional things. If it is
  * defined, it's inserted at the beginning of received message processing.
  * If you eat the received message and don't want default processing to
  * proceed, do a return after doing your things. One possible application
  * (besides debugging) is to flash a status LED on each packet.
+ * Here, it tracks the DEVICE_REMOTE_WAKEUP feature, outside of the driver.
  */
+#if USB_CFG_REMOTE_WAKEUP
+#define USB_RESET_HOOK(resetStarts)     if(resetStarts){power_usb_reset();}
+#else
 /* #define USB_RESET_HOOK(resetStarts)     if(!resetStarts){hadUsbReset();} */
+#endif
 /* This macro is a hook if you need to know when an USB RESET occurs. It has
  * one parameter which distinguishes between the start of RESET state and its
  * end.
@@ -346,12 +365,18 @@ section at the end of this file).
  */
 
 #define USB_CFG_DESCR_PROPS_DEVICE                  0
-#define USB_CFG_DESCR_PROPS_CONFIGURATION           0
+#define USB_CFG_DESCR_PROPS_CONFIGURATION           USB_PROP_LENGTH(9 + 3 * 9 + 4 * 7)
+/* Supplied by main.c, for the remote wakeup attribute: the configuration, with
+ * 3 interfaces & 4 interrupt endpoints
+ */
 #define USB_CFG_DESCR_PROPS_STRINGS                 0
 #define USB_CFG_DESCR_PROPS_STRING_0                0
 #define USB_CFG_DESCR_PROPS_STRING_VENDOR           0
 #define USB_CFG_DESCR_PROPS_STRING_PRODUCT          0
-#define USB_CFG_DESCR_PROPS_STRING_SERIAL_NUMBER    0
+#define USB_CFG_DESCR_PROPS_STRING_SERIAL_NUMBER    (USB_PROP_IS_DYNAMIC | USB_PROP_IS_RAM)
+/* The serial number is read from the EEPROM, just after the memory accessible
+ * part, by usbFunctionDescriptor() in main.c
+ */
 #define USB_CFG_DESCR_PROPS_HID                     0
 #define USB_CFG_DESCR_PROPS_HID_REPORT              0
 #define USB_CFG_DESCR_PROPS_UNKNOWN                 0